@@ -0,0 +1,207 @@
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LANES 8
+typedef __m256 vfloat;
+#define v_load(p) _mm256_loadu_ps(p)
+#define v_store(p, a) _mm256_storeu_ps(p, a)
+#define v_add(a, b) _mm256_add_ps(a, b)
+#define v_sub(a, b) _mm256_sub_ps(a, b)
+#define v_mul(a, b) _mm256_mul_ps(a, b)
+#define v_div(a, b) _mm256_div_ps(a, b)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define LANES 4
+typedef __m128 vfloat;
+#define v_load(p) _mm_loadu_ps(p)
+#define v_store(p, a) _mm_storeu_ps(p, a)
+#define v_add(a, b) _mm_add_ps(a, b)
+#define v_sub(a, b) _mm_sub_ps(a, b)
+#define v_mul(a, b) _mm_mul_ps(a, b)
+#define v_div(a, b) _mm_div_ps(a, b)
+#else
+#define LANES 1
+typedef float vfloat;
+#define v_load(p) (*(p))
+#define v_store(p, a) (*(p) = (a))
+#define v_add(a, b) ((a) + (b))
+#define v_sub(a, b) ((a) - (b))
+#define v_mul(a, b) ((a) * (b))
+#define v_div(a, b) ((a) / (b))
+#endif
+
+#define BATCH_MAX_CELLS (MAX_ROWS * BATCH_MAX_COLS)
+
+// Systems gathered per block; wide enough that each cell of the batch is read
+// as a few whole cache lines rather than one page touch per vector
+#define BLOCK (LANES * 8)
+
+// One block of systems copied into a contiguous buffer, so the elimination
+// runs out of L1 whatever the batch stride is
+typedef struct {
+    float re[BATCH_MAX_CELLS][BLOCK];
+    float im[BATCH_MAX_CELLS][BLOCK];
+} Block;
+
+static void swap_lane_rows(Block *c, int cols, int lane, int a, int b)
+{
+    for (int j = 0; j < cols; j++)
+    {
+        float temp = c->re[a * cols + j][lane];
+        c->re[a * cols + j][lane] = c->re[b * cols + j][lane];
+        c->re[b * cols + j][lane] = temp;
+
+        temp = c->im[a * cols + j][lane];
+        c->im[a * cols + j][lane] = c->im[b * cols + j][lane];
+        c->im[b * cols + j][lane] = temp;
+    }
+}
+
+// Same elimination as complex_rref on the LANES systems starting at lane
+// base, with every lane pivoting on the current column. Returns a mask of the
+// lanes where that assumption did not hold.
+static unsigned eliminate_lanes(Block *c, int base, int rows, int cols)
+{
+    unsigned failed = 0;
+
+    for (int r = 0; r < rows && r < cols; r++)
+    {
+        // Find pivot; same rule as complex_rref (compared squared), per lane
+        for (int lane = base; lane < base + LANES; lane++)
+        {
+            int i = r;
+            while (i < rows)
+            {
+                Complex a = {c->re[i * cols + r][lane], c->im[i * cols + r][lane]};
+                if (a.r * a.r + a.i * a.i >= EPSILON * EPSILON)
+                {
+                    break;
+                }
+                i++;
+            }
+
+            if (i == rows)
+            {
+                // Keep the lane finite; its result is replaced by the
+                // scalar path
+                failed |= 1u << (lane - base);
+                c->re[r * cols + r][lane] = 1;
+                c->im[r * cols + r][lane] = 0;
+            } else if (i != r)
+            {
+                swap_lane_rows(c, cols, lane, r, i);
+            }
+        }
+
+        // Normalize row; columns left of the pivot are already zero in every
+        // lane, so both loops start at the pivot column
+        const vfloat divR = v_load(c->re[r * cols + r] + base);
+        const vfloat divI = v_load(c->im[r * cols + r] + base);
+        const vfloat denom = v_add(v_mul(divR, divR), v_mul(divI, divI));
+        for (int j = r; j < cols; j++)
+        {
+            const vfloat aR = v_load(c->re[r * cols + j] + base);
+            const vfloat aI = v_load(c->im[r * cols + j] + base);
+            v_store(c->re[r * cols + j] + base, v_div(v_add(v_mul(aR, divR), v_mul(aI, divI)), denom));
+            v_store(c->im[r * cols + j] + base, v_div(v_sub(v_mul(aI, divR), v_mul(aR, divI)), denom));
+        }
+
+        // Eliminate other rows
+        for (int k = 0; k < rows; k++)
+        {
+            if (k != r)
+            {
+                const vfloat mulR = v_load(c->re[k * cols + r] + base);
+                const vfloat mulI = v_load(c->im[k * cols + r] + base);
+                for (int j = r; j < cols; j++)
+                {
+                    const vfloat pR = v_load(c->re[r * cols + j] + base);
+                    const vfloat pI = v_load(c->im[r * cols + j] + base);
+                    const vfloat termR = v_sub(v_mul(mulR, pR), v_mul(mulI, pI));
+                    const vfloat termI = v_add(v_mul(mulR, pI), v_mul(mulI, pR));
+                    v_store(c->re[k * cols + j] + base, v_sub(v_load(c->re[k * cols + j] + base), termR));
+                    v_store(c->im[k * cols + j] + base, v_sub(v_load(c->im[k * cols + j] + base), termI));
+                }
+            }
+        }
+    }
+    return failed;
+}
+
+static void solve_scalar(int count, int rows, int cols, float *re, float *im, int s, Complex *dest)
+{
+    Complex matrix[BATCH_MAX_CELLS];
+    for (int cell = 0; cell < rows * cols; cell++)
+    {
+        matrix[cell].r = re[cell * count + s];
+        matrix[cell].i = im[cell * count + s];
+    }
+
+    Complex *solved = complex_rref(rows, cols, matrix);
+    memcpy(dest, solved, sizeof(Complex) * rows * cols);
+    free(solved);
+}
+
+int complex_rref_batch(int count, int rows, int cols, float *re, float *im)
+{
+    if (rows > MAX_ROWS || cols > BATCH_MAX_COLS)
+    {
+        return -1;
+    }
+
+    const int cells = rows * cols;
+    int fallbacks = 0;
+    Block block;
+
+    for (int start = 0; start < count; start += BLOCK)
+    {
+        const int lanes = count - start < BLOCK ? count - start : BLOCK;
+
+        // Gather; a short tail block repeats its last system in the spare lanes
+        for (int cell = 0; cell < cells; cell++)
+        {
+            const float *srcR = &re[cell * count + start];
+            const float *srcI = &im[cell * count + start];
+            memcpy(block.re[cell], srcR, sizeof(float) * lanes);
+            memcpy(block.im[cell], srcI, sizeof(float) * lanes);
+            for (int lane = lanes; lane < BLOCK; lane++)
+            {
+                block.re[cell][lane] = srcR[lanes - 1];
+                block.im[cell][lane] = srcI[lanes - 1];
+            }
+        }
+
+        for (int base = 0; base < lanes; base += LANES)
+        {
+            const unsigned failed = eliminate_lanes(&block, base, rows, cols);
+
+            // Lanes that skipped a column go through the scalar path, read
+            // from the still untouched input
+            for (int lane = base; lane < base + LANES && lane < lanes; lane++)
+            {
+                if (failed & (1u << (lane - base)))
+                {
+                    Complex solved[BATCH_MAX_CELLS];
+                    solve_scalar(count, rows, cols, re, im, start + lane, solved);
+                    for (int cell = 0; cell < cells; cell++)
+                    {
+                        block.re[cell][lane] = solved[cell].r;
+                        block.im[cell][lane] = solved[cell].i;
+                    }
+                    fallbacks++;
+                }
+            }
+        }
+
+        // Scatter
+        for (int cell = 0; cell < cells; cell++)
+        {
+            memcpy(&re[cell * count + start], block.re[cell], sizeof(float) * lanes);
+            memcpy(&im[cell * count + start], block.im[cell], sizeof(float) * lanes);
+        }
+    }
+    return fallbacks;
+}
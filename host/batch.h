@@ -0,0 +1,17 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "solver.h"
+
+#define BATCH_MAX_COLS (MAX_ROWS + 1)
+
+// RREF of count independent systems of the same shape, in place.
+// The systems are stored structure-of-arrays with the real and imaginary
+// parts split and the systems interleaved: cell (i, j) of system s lives at
+// re[(i * cols + j) * count + s] and im[(i * cols + j) * count + s].
+// Returns the number of systems that needed the scalar complex_rref because
+// a column had no pivot, or -1 if the shape is larger than
+// MAX_ROWS x BATCH_MAX_COLS.
+int complex_rref_batch(int count, int rows, int cols, float *re, float *im);
+
+#endif
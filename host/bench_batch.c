@@ -0,0 +1,91 @@
+// Systems per second of complex_rref_batch against calling complex_rref on
+// each system in turn, for random systems of a few shapes.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "batch.h"
+
+#define DEFAULT_COUNT 100000
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static float random_unit(void)
+{
+    return 2.0f * rand() / RAND_MAX - 1.0f;
+}
+
+int main(int argc, char **argv)
+{
+    const int count = argc > 1 ? atoi(argv[1]) : DEFAULT_COUNT;
+    static const int shapes[][2] = {{3, 4}, {6, 7}, {9, 10}};
+
+    printf("%6s %8s | %12s %12s %8s | %10s\n", "shape", "systems", "scalar/s", "batch/s", "speedup", "max diff");
+
+    srand(1);
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++)
+    {
+        const int rows = shapes[s][0];
+        const int cols = shapes[s][1];
+        const int cells = rows * cols;
+
+        Complex *systems = (Complex *) malloc(sizeof(Complex) * cells * count);
+        float *re = (float *) malloc(sizeof(float) * cells * count);
+        float *im = (float *) malloc(sizeof(float) * cells * count);
+
+        for (int k = 0; k < count; k++)
+        {
+            for (int cell = 0; cell < cells; cell++)
+            {
+                systems[k * cells + cell].r = random_unit();
+                systems[k * cells + cell].i = random_unit();
+                re[cell * count + k] = systems[k * cells + cell].r;
+                im[cell * count + k] = systems[k * cells + cell].i;
+            }
+        }
+
+        double start = now();
+        for (int k = 0; k < count; k++)
+        {
+            Complex *solved = complex_rref(rows, cols, &systems[k * cells]);
+            memcpy(&systems[k * cells], solved, sizeof(Complex) * cells);
+            free(solved);
+        }
+        const double scalarTime = now() - start;
+
+        start = now();
+        const int fallbacks = complex_rref_batch(count, rows, cols, re, im);
+        const double batchTime = now() - start;
+
+        float diff = 0;
+        for (int k = 0; k < count; k++)
+        {
+            for (int cell = 0; cell < cells; cell++)
+            {
+                diff = fmaxf(diff, fabsf(systems[k * cells + cell].r - re[cell * count + k]));
+                diff = fmaxf(diff, fabsf(systems[k * cells + cell].i - im[cell * count + k]));
+            }
+        }
+
+        char shape[16];
+        sprintf(shape, "%dx%d", rows, cols);
+        printf("%6s %8d | %12.0f %12.0f %7.2fx | %10.2e", shape, count, count / scalarTime, count / batchTime,
+               scalarTime / batchTime, diff);
+        if (fallbacks)
+        {
+            printf("  (%d scalar fallbacks)", fallbacks);
+        }
+        printf("\n");
+
+        free(systems);
+        free(re);
+        free(im);
+    }
+    return 0;
+}
@@ -0,0 +1,183 @@
+// GFLOP/s of complex_rref_blocked for n unknowns (an n x n+1 system) and
+// its scaling with threads, against complex_rref where that finishes in
+// reasonable time. Flops are counted as 4n^3, the complex multiply-adds a
+// Gauss-Jordan elimination needs, for every solver. The matrices are random
+// with a heavy diagonal, like nodal analysis matrices, so that the max diff
+// column measures agreement rather than conditioning.
+//
+// A second table checks the pivoting against complex_rref_inplace on matrices
+// with some zero diagonal entries (row swaps) and one zero column (a skipped
+// pivot column, rank n - 1), comparing the whole result and the pivot count.
+//
+// usage: bench_blocked [max threads] [sizes...]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "blocked.h"
+
+#define SCALAR_MAX 1024
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static float random_unit(void)
+{
+    return 2.0f * rand() / RAND_MAX - 1.0f;
+}
+
+// Largest difference over every entry, relative to the reference entry
+static float max_diff(long count, const Complex *A, const Complex *reference)
+{
+    float diff = 0;
+    for (long k = 0; k < count; k++)
+    {
+        diff = fmaxf(diff, c_abs(c_sub(A[k], reference[k])) / fmaxf(1, c_abs(reference[k])));
+    }
+    return diff;
+}
+
+// Powers of two below maxThreads, then maxThreads itself, then 0 to stop
+static int next_threads(int threads, int maxThreads)
+{
+    if (threads >= maxThreads)
+    {
+        return 0;
+    }
+    return threads * 2 < maxThreads ? threads * 2 : maxThreads;
+}
+
+static void check_pivoting(Pool *pool, int n)
+{
+    const int cols = n + 1;
+    const size_t bytes = sizeof(Complex) * n * cols;
+    Complex *reference = (Complex *) malloc(bytes);
+    Complex *A = (Complex *) malloc(bytes);
+
+    for (long k = 0; k < (long) n * cols; k++)
+    {
+        reference[k].r = random_unit();
+        reference[k].i = random_unit();
+    }
+    for (int i = 0; i < n; i++)
+    {
+        // Every third diagonal entry is zero, so those rows need a swap
+        reference[i * cols + i].r = i % 3 == 0 ? 0 : reference[i * cols + i].r + n;
+        reference[i * cols + i].i = i % 3 == 0 ? 0 : reference[i * cols + i].i;
+        reference[i * cols + n / 2].r = 0;
+        reference[i * cols + n / 2].i = 0;
+    }
+    memcpy(A, reference, bytes);
+
+    const int referencePivots = complex_rref_inplace(n, cols, reference);
+    const int blockedPivots = complex_rref_blocked(pool, n, cols, A);
+    printf("%6d %8d %8d | %10.2e\n", n, referencePivots, blockedPivots, max_diff((long) n * cols, A, reference));
+
+    free(reference);
+    free(A);
+}
+
+int main(int argc, char **argv)
+{
+    int maxThreads = argc > 1 ? atoi(argv[1]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    static const int defaultSizes[] = {256, 512, 1024, 2048, 4096};
+    int sizes[16];
+    int sizeCount = 0;
+
+    if (argc > 2)
+    {
+        for (int k = 2; k < argc && sizeCount < 16; k++)
+        {
+            sizes[sizeCount++] = atoi(argv[k]);
+        }
+    } else
+    {
+        for (size_t k = 0; k < sizeof(defaultSizes) / sizeof(defaultSizes[0]); k++)
+        {
+            sizes[sizeCount++] = defaultSizes[k];
+        }
+    }
+    if (maxThreads < 1)
+    {
+        maxThreads = 1;
+    }
+
+    printf("%6s %8s | %10s %10s %8s | %10s\n", "n", "threads", "seconds", "GFLOP/s", "speedup", "max diff");
+
+    srand(1);
+    for (int s = 0; s < sizeCount; s++)
+    {
+        const int n = sizes[s];
+        const int cols = n + 1;
+        const size_t bytes = sizeof(Complex) * n * cols;
+        const double flops = 4.0 * n * n * n;
+
+        Complex *matrix = (Complex *) malloc(bytes);
+        Complex *A = (Complex *) malloc(bytes);
+        Complex *reference = NULL;
+        for (long k = 0; k < (long) n * cols; k++)
+        {
+            matrix[k].r = random_unit();
+            matrix[k].i = random_unit();
+        }
+        for (int i = 0; i < n; i++)
+        {
+            matrix[i * cols + i].r += n;
+        }
+
+        if (n <= SCALAR_MAX)
+        {
+            const double start = now();
+            reference = complex_rref(n, cols, matrix);
+            const double elapsed = now() - start;
+            printf("%6d %8s | %10.3f %10.2f %8s |\n", n, "rref", elapsed, flops / elapsed * 1e-9, "");
+        }
+
+        double single = 0;
+        for (int threads = 1; threads > 0; threads = next_threads(threads, maxThreads))
+        {
+            Pool *pool = pool_create(threads);
+            memcpy(A, matrix, bytes);
+
+            const double start = now();
+            complex_rref_blocked(pool, n, cols, A);
+            const double elapsed = now() - start;
+            pool_destroy(pool);
+
+            if (threads == 1)
+            {
+                single = elapsed;
+            }
+
+            printf("%6d %8d | %10.3f %10.2f %7.2fx |", n, threads, elapsed, flops / elapsed * 1e-9,
+                   single / elapsed);
+            if (reference != NULL)
+            {
+                printf(" %10.2e", max_diff((long) n * cols, A, reference));
+            }
+            printf("\n");
+        }
+
+        free(reference);
+        free(matrix);
+        free(A);
+    }
+
+    printf("\n%6s %8s %8s | %10s\n", "n", "rref", "blocked", "max diff");
+    Pool *pool = pool_create(maxThreads);
+    for (int s = 0; s < sizeCount; s++)
+    {
+        if (sizes[s] <= SCALAR_MAX)
+        {
+            check_pivoting(pool, sizes[s]);
+        }
+    }
+    pool_destroy(pool);
+    return 0;
+}
@@ -0,0 +1,196 @@
+// Accuracy against time for the float RREF, the refined single precision
+// solve and a plain long double Gauss-Jordan on host. Host long double is
+// hardware backed, so the long double column understates its cost on the
+// eZ80, where it is soft-float.
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "solver.h"
+
+#define SYSTEMS 64
+#define REPEATS 200
+
+typedef struct {
+    long double r;
+    long double i;
+} LongComplex;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static float random_unit(void)
+{
+    return 2.0f * rand() / RAND_MAX - 1.0f;
+}
+
+// Random system whose last row is the first row plus a perturbation of size
+// t, so the condition number grows roughly like 1/t
+static void make_system(int n, float t, Complex *matrix)
+{
+    const int cols = n + 1;
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            matrix[i * cols + j].r = random_unit();
+            matrix[i * cols + j].i = random_unit();
+        }
+    }
+    for (int j = 0; j < n; j++)
+    {
+        matrix[(n - 1) * cols + j].r = matrix[j].r + t * random_unit();
+        matrix[(n - 1) * cols + j].i = matrix[j].i + t * random_unit();
+    }
+}
+
+// Gauss-Jordan with partial pivoting in long double, used as the reference
+static void long_solve(int n, const Complex *matrix, LongComplex *x)
+{
+    const int cols = n + 1;
+    LongComplex A[MAX_ROWS * (MAX_ROWS + 1)];
+
+    for (int i = 0; i < n * cols; i++)
+    {
+        A[i].r = matrix[i].r;
+        A[i].i = matrix[i].i;
+    }
+
+    for (int c = 0; c < n; c++)
+    {
+        int p = c;
+        for (int i = c + 1; i < n; i++)
+        {
+            if (hypotl(A[i * cols + c].r, A[i * cols + c].i) > hypotl(A[p * cols + c].r, A[p * cols + c].i))
+            {
+                p = i;
+            }
+        }
+        for (int j = 0; j < cols; j++)
+        {
+            LongComplex temp = A[c * cols + j];
+            A[c * cols + j] = A[p * cols + j];
+            A[p * cols + j] = temp;
+        }
+
+        const LongComplex div = A[c * cols + c];
+        const long double denom = div.r * div.r + div.i * div.i;
+        for (int j = 0; j < cols; j++)
+        {
+            const LongComplex a = A[c * cols + j];
+            A[c * cols + j].r = (a.r * div.r + a.i * div.i) / denom;
+            A[c * cols + j].i = (a.i * div.r - a.r * div.i) / denom;
+        }
+
+        for (int k = 0; k < n; k++)
+        {
+            if (k != c)
+            {
+                const LongComplex mul = A[k * cols + c];
+                for (int j = 0; j < cols; j++)
+                {
+                    const LongComplex a = A[c * cols + j];
+                    A[k * cols + j].r -= mul.r * a.r - mul.i * a.i;
+                    A[k * cols + j].i -= mul.r * a.i + mul.i * a.r;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        x[i] = A[i * cols + n];
+    }
+}
+
+static double relative_error(int n, const Complex *solved, const LongComplex *reference)
+{
+    long double err = 0;
+    long double norm = 0;
+    for (int i = 0; i < n; i++)
+    {
+        const long double dr = solved[i * (n + 1) + n].r - reference[i].r;
+        const long double di = solved[i * (n + 1) + n].i - reference[i].i;
+        err = fmaxl(err, hypotl(dr, di));
+        norm = fmaxl(norm, hypotl(reference[i].r, reference[i].i));
+    }
+    return (double) (err / norm);
+}
+
+int main(void)
+{
+    static const float perturbations[] = {1e-1f, 1e-2f, 1e-3f, 1e-4f};
+    static Complex systems[SYSTEMS][MAX_ROWS * (MAX_ROWS + 1)];
+    static LongComplex reference[SYSTEMS][MAX_ROWS];
+
+    printf("%2s %8s | %10s %10s %10s | %9s %9s %9s\n", "n", "perturb", "err rref", "err refine", "residual",
+           "us rref", "us refine", "us long");
+
+    srand(1);
+    for (int n = 3; n <= MAX_ROWS; n += 3)
+    {
+        for (size_t t = 0; t < sizeof(perturbations) / sizeof(perturbations[0]); t++)
+        {
+            for (int s = 0; s < SYSTEMS; s++)
+            {
+                make_system(n, perturbations[t], systems[s]);
+                long_solve(n, systems[s], reference[s]);
+            }
+
+            double errRref = 0;
+            double errRefine = 0;
+            float worstResidual = 0;
+            for (int s = 0; s < SYSTEMS; s++)
+            {
+                float residual;
+                Complex *rref = complex_rref(n, n + 1, systems[s]);
+                Complex *refined = complex_solve(n, n + 1, systems[s], &residual);
+                errRref = fmax(errRref, relative_error(n, rref, reference[s]));
+                errRefine = fmax(errRefine, relative_error(n, refined, reference[s]));
+                worstResidual = fmaxf(worstResidual, residual);
+                free(rref);
+                free(refined);
+            }
+
+            double start = now();
+            for (int k = 0; k < REPEATS; k++)
+            {
+                for (int s = 0; s < SYSTEMS; s++)
+                {
+                    free(complex_rref(n, n + 1, systems[s]));
+                }
+            }
+            const double rrefTime = (now() - start) / (REPEATS * SYSTEMS) * 1e6;
+
+            start = now();
+            for (int k = 0; k < REPEATS; k++)
+            {
+                for (int s = 0; s < SYSTEMS; s++)
+                {
+                    float residual;
+                    free(complex_solve(n, n + 1, systems[s], &residual));
+                }
+            }
+            const double refineTime = (now() - start) / (REPEATS * SYSTEMS) * 1e6;
+
+            start = now();
+            for (int k = 0; k < REPEATS; k++)
+            {
+                for (int s = 0; s < SYSTEMS; s++)
+                {
+                    LongComplex x[MAX_ROWS];
+                    long_solve(n, systems[s], x);
+                }
+            }
+            const double longTime = (now() - start) / (REPEATS * SYSTEMS) * 1e6;
+
+            printf("%2d %8.0e | %10.2e %10.2e %10.2e | %9.3f %9.3f %9.3f\n", n, perturbations[t], errRref,
+                   errRefine, worstResidual, rrefTime, refineTime, longTime);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,307 @@
+#include <stdlib.h>
+#include <string.h>
+#include "blocked.h"
+
+// Trailing columns per tile of the update; a tile of the pivot rows
+// (PANEL_WIDTH x TILE_COLS complex) stays in L2 while every row streams past it
+#define TILE_COLS 256
+
+// Columns per piece when solving the pivot rows
+#define SOLVE_GRAIN 64
+
+// Rows per piece of the update
+#define UPDATE_GRAIN 16
+
+typedef struct {
+    int rows;
+    int cols;
+    Complex *A;
+
+    // Panel state: pivot rows r0..r0 + width - 1 own columns k0..k0 + width - 1
+    int r0;
+    int k0;
+    int width;
+    const Complex *lu; // (rows - r0) x PANEL_WIDTH, factored panel
+
+    // Columns that found no pivot keep being updated, as in
+    // complex_rref_inplace; the update covers [skipped, k0) and
+    // [k0 + width, cols). skipped is k0 while no column has been skipped.
+    int skipped;
+} Step;
+
+// Splits [begin, end) of the updated columns, numbered across both segments,
+// into at most two ranges of matrix columns
+static int column_ranges(const Step *s, long begin, long end, long ranges[2][2])
+{
+    const long left = s->k0 - s->skipped;
+    const long right = s->k0 + s->width - left;
+    int count = 0;
+
+    if (begin < left)
+    {
+        ranges[count][0] = s->skipped + begin;
+        ranges[count][1] = s->skipped + (end < left ? end : left);
+        count++;
+    }
+    if (end > left)
+    {
+        ranges[count][0] = right + (begin > left ? begin : left);
+        ranges[count][1] = right + end;
+        count++;
+    }
+    return count;
+}
+
+// row -= m * pivotRow over columns [from, to)
+static void row_axpy(Complex *row, Complex m, const Complex *pivotRow, long from, long to)
+{
+    for (long c = from; c < to; c++)
+    {
+        const float pr = pivotRow[c].r;
+        const float pi = pivotRow[c].i;
+        row[c].r -= m.r * pr - m.i * pi;
+        row[c].i -= m.r * pi + m.i * pr;
+    }
+}
+
+// Panel LU of the rows below r0 in a copy of the panel columns, choosing the
+// pivot of each column exactly like complex_rref_inplace: the first row whose
+// entry is not below EPSILON. Stops at the first column without a pivot and
+// returns how many columns were factored; perm[j] is the local row swapped
+// into position j.
+static int factor_panel(Complex *P, int height, int nb, int *perm)
+{
+    for (int j = 0; j < nb; j++)
+    {
+        int p = j;
+        while (p < height && c_abs(P[p * PANEL_WIDTH + j]) < EPSILON)
+        {
+            p++;
+        }
+        if (p == height)
+        {
+            return j;
+        }
+
+        perm[j] = p;
+        if (p != j)
+        {
+            for (int c = 0; c < nb; c++)
+            {
+                Complex temp = P[j * PANEL_WIDTH + c];
+                P[j * PANEL_WIDTH + c] = P[p * PANEL_WIDTH + c];
+                P[p * PANEL_WIDTH + c] = temp;
+            }
+        }
+
+        const Complex pivot = P[j * PANEL_WIDTH + j];
+        for (int i = j + 1; i < height; i++)
+        {
+            Complex *row = &P[i * PANEL_WIDTH];
+            row[j] = c_div(row[j], pivot);
+            row_axpy(row, row[j], &P[j * PANEL_WIDTH], j + 1, nb);
+        }
+    }
+    return nb;
+}
+
+// Pivot rows, columns [from, to): replaces A_RT by A_RP^-1 A_RT using the
+// panel's unit lower and upper factors, row by row
+static void solve_columns(const Step *s, long from, long to)
+{
+    for (int i = 0; i < s->width; i++)
+    {
+        Complex *row = &s->A[(s->r0 + i) * s->cols];
+        for (int k = 0; k < i; k++)
+        {
+            row_axpy(row, s->lu[i * PANEL_WIDTH + k], &s->A[(s->r0 + k) * s->cols], from, to);
+        }
+    }
+
+    const Complex one = {1, 0};
+    for (int i = s->width - 1; i >= 0; i--)
+    {
+        Complex *row = &s->A[(s->r0 + i) * s->cols];
+        for (int k = i + 1; k < s->width; k++)
+        {
+            row_axpy(row, s->lu[i * PANEL_WIDTH + k], &s->A[(s->r0 + k) * s->cols], from, to);
+        }
+
+        const Complex inv = c_div(one, s->lu[i * PANEL_WIDTH + i]);
+        for (long c = from; c < to; c++)
+        {
+            const float r = row[c].r;
+            row[c].r = r * inv.r - row[c].i * inv.i;
+            row[c].i = r * inv.i + row[c].i * inv.r;
+        }
+    }
+}
+
+static void solve_pivot_rows(void *ctx, int worker, long begin, long end)
+{
+    (void) worker;
+    const Step *s = (const Step *) ctx;
+    long ranges[2][2];
+    const int count = column_ranges(s, begin, end, ranges);
+
+    for (int k = 0; k < count; k++)
+    {
+        solve_columns(s, ranges[k][0], ranges[k][1]);
+    }
+}
+
+// Row i, columns [from, to): row -= A_iP * (A_RP^-1 A_RT). A_iP still holds
+// the panel columns from before the panel was factored, since that happened
+// in a copy.
+static void update_row(const Step *s, long i, long from, long to)
+{
+    float *row = (float *) &s->A[i * s->cols];
+    const Complex *panel = &s->A[i * s->cols + s->k0];
+
+    int k = 0;
+    // Four pivot rows at a time, so each entry is loaded and stored once per
+    // four multiply-adds
+    for (; k + 4 <= s->width; k += 4)
+    {
+        const float *p0 = (const float *) &s->A[(s->r0 + k) * s->cols];
+        const float *p1 = (const float *) &s->A[(s->r0 + k + 1) * s->cols];
+        const float *p2 = (const float *) &s->A[(s->r0 + k + 2) * s->cols];
+        const float *p3 = (const float *) &s->A[(s->r0 + k + 3) * s->cols];
+        const float a0r = panel[k].r, a0i = panel[k].i;
+        const float a1r = panel[k + 1].r, a1i = panel[k + 1].i;
+        const float a2r = panel[k + 2].r, a2i = panel[k + 2].i;
+        const float a3r = panel[k + 3].r, a3i = panel[k + 3].i;
+
+        for (long c = 2 * from; c < 2 * to; c += 2)
+        {
+            row[c] -= a0r * p0[c] - a0i * p0[c + 1] + a1r * p1[c] - a1i * p1[c + 1]
+                      + a2r * p2[c] - a2i * p2[c + 1] + a3r * p3[c] - a3i * p3[c + 1];
+            row[c + 1] -= a0r * p0[c + 1] + a0i * p0[c] + a1r * p1[c + 1] + a1i * p1[c]
+                          + a2r * p2[c + 1] + a2i * p2[c] + a3r * p3[c + 1] + a3i * p3[c];
+        }
+    }
+    for (; k < s->width; k++)
+    {
+        const float *p = (const float *) &s->A[(s->r0 + k) * s->cols];
+        const float ar = panel[k].r, ai = panel[k].i;
+        for (long c = 2 * from; c < 2 * to; c += 2)
+        {
+            row[c] -= ar * p[c] - ai * p[c + 1];
+            row[c + 1] -= ar * p[c + 1] + ai * p[c];
+        }
+    }
+}
+
+// Rows [begin, end) of the rows outside the pivot rows, tile by tile so the
+// pivot rows' tile is reused by every row of the piece
+static void update_rows(void *ctx, int worker, long begin, long end)
+{
+    (void) worker;
+    const Step *s = (const Step *) ctx;
+    long ranges[2][2];
+    const int count = column_ranges(s, 0, (s->k0 - s->skipped) + (s->cols - s->k0 - s->width), ranges);
+
+    for (int r = 0; r < count; r++)
+    {
+        for (long tile = ranges[r][0]; tile < ranges[r][1]; tile += TILE_COLS)
+        {
+            const long tileEnd = tile + TILE_COLS < ranges[r][1] ? tile + TILE_COLS : ranges[r][1];
+            for (long o = begin; o < end; o++)
+            {
+                update_row(s, o < s->r0 ? o : o + s->width, tile, tileEnd);
+            }
+        }
+    }
+}
+
+int complex_rref_blocked(Pool *pool, int rows, int cols, Complex *A)
+{
+    if (rows < BLOCKED_MIN_ROWS)
+    {
+        return complex_rref_inplace(rows, cols, A);
+    }
+
+    Complex *P = (Complex *) malloc(sizeof(Complex) * rows * PANEL_WIDTH);
+    int perm[PANEL_WIDTH];
+    int pivots = 0;
+    int skippedAny = 0;
+    Step s = {rows, cols, A, 0, 0, 0, P, 0};
+
+    while (s.r0 < rows && s.k0 < cols)
+    {
+        int nb = PANEL_WIDTH;
+        if (nb > cols - s.k0)
+        {
+            nb = cols - s.k0;
+        }
+        if (nb > rows - s.r0)
+        {
+            nb = rows - s.r0;
+        }
+
+        const int height = rows - s.r0;
+        for (int i = 0; i < height; i++)
+        {
+            memcpy(&P[i * PANEL_WIDTH], &A[(s.r0 + i) * cols + s.k0], sizeof(Complex) * nb);
+        }
+
+        s.width = factor_panel(P, height, nb, perm);
+        if (s.width == 0)
+        {
+            // No pivot in this column; complex_rref_inplace moves on to the
+            // next column, which stays in the update from now on
+            skippedAny = 1;
+            s.k0++;
+            continue;
+        }
+
+        for (int j = 0; j < s.width; j++)
+        {
+            if (perm[j] != j)
+            {
+                Complex *a = &A[(s.r0 + j) * cols];
+                Complex *b = &A[(s.r0 + perm[j]) * cols];
+                for (int c = 0; c < cols; c++)
+                {
+                    Complex temp = a[c];
+                    a[c] = b[c];
+                    b[c] = temp;
+                }
+            }
+        }
+
+        const int trailing = (s.k0 - s.skipped) + (cols - s.k0 - s.width);
+        if (trailing > 0)
+        {
+            pool_run(pool, trailing, SOLVE_GRAIN, solve_pivot_rows, &s);
+            pool_run(pool, rows - s.width, UPDATE_GRAIN, update_rows, &s);
+        }
+
+        // The panel columns end up as unit vectors
+        for (int i = 0; i < rows; i++)
+        {
+            for (int j = 0; j < s.width; j++)
+            {
+                A[i * cols + s.k0 + j].r = i == s.r0 + j;
+                A[i * cols + s.k0 + j].i = 0;
+            }
+        }
+
+        for (int j = 0; j < s.width; j++)
+        {
+            if (s.k0 + j < cols - 1)
+            {
+                pivots++;
+            }
+        }
+        s.r0 += s.width;
+        s.k0 += s.width;
+        if (!skippedAny)
+        {
+            s.skipped = s.k0;
+        }
+    }
+
+    free(P);
+    return pivots;
+}
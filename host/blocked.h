@@ -0,0 +1,19 @@
+#ifndef BLOCKED_H
+#define BLOCKED_H
+
+#include "solver.h"
+#include "pool.h"
+
+// Columns factored per panel
+#define PANEL_WIDTH 48
+
+// Matrices with fewer rows than this go straight to complex_rref_inplace
+#define BLOCKED_MIN_ROWS (2 * PANEL_WIDTH)
+
+// Same result as complex_rref_inplace, same pivot rule, for large matrices:
+// panels of PANEL_WIDTH columns are factored serially, then the rest of the
+// matrix is updated with cache-tiled products spread over the pool's threads.
+// Returns the number of pivots found left of the last column.
+int complex_rref_blocked(Pool *pool, int rows, int cols, Complex *A);
+
+#endif
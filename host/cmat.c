@@ -0,0 +1,869 @@
+// cmat: streams systems from a file, solves each one and streams the RREF
+// back out. Reading, solving and writing run on three threads connected by
+// bounded queues of batches, and batches are recycled, so steady state does
+// no allocation and throughput is set by the slowest stage.
+//
+// Text format, whitespace separated, any number of systems:
+//   rows cols
+//   rows * cols cells in calculator syntax, e.g. 10 -2.5 3-4i
+// rows and cols are at most MAX_DIMENSION in either format, and text cells at
+// most TOKEN_SIZE - 1 characters; anything larger is an error.
+//
+// Binary format (native byte order):
+//   "CMAT" uint32 version (1)
+//   per system: uint16 rows, uint16 cols, rows * cols pairs of float32 (re, im)
+//
+// Either format is recognised by its header, on stdin as well. Regular files
+// are memory-mapped; text from a file is only split into systems by the
+// reader, and the cells are parsed on the solving thread and its pool. Text
+// from a pipe is parsed by the reader.
+//
+// usage: cmat [-B] [-x] [-v] [-p precision] [-t threads] [input [output]]
+//   -B  write the binary format          -x  copy without solving
+//   -v  print throughput to stderr       -t  threads for parsing and solving
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "solver.h"
+#include "format.h"
+#include "pool.h"
+#include "blocked.h"
+
+#define BINARY_MAGIC "CMAT"
+#define BINARY_VERSION 1
+
+#define BATCH_SYSTEMS 4096
+#define BATCH_CELLS (1 << 16)
+#define BATCHES 4
+
+// Largest rows or cols accepted; well inside the binary format's uint16 and
+// 2 GB of cells for the largest system
+#define MAX_DIMENSION 16384
+
+// Cells longer than TOKEN_SIZE - 1 characters are rejected
+#define TOKEN_SIZE 64
+
+// Longest %.9f of a float: sign, 39 digits, point and 9 decimals, plus the
+// NUL. A cell is two parts, '+', 'i' and a separator.
+#define PART_TEXT_SIZE 51
+#define CELL_TEXT_SIZE (2 * PART_TEXT_SIZE + 3)
+
+// Systems per piece when a batch is spread over the pool
+#define SYSTEMS_GRAIN 64
+
+typedef struct {
+    int rows;
+    int cols;
+    long offset;
+    // First cell in the mapped text when the cells are still to be parsed
+    const char *text;
+} Shape;
+
+typedef struct {
+    int count;
+    long used;
+    long capacity;
+    Shape shapes[BATCH_SYSTEMS];
+    Complex *cells;
+} Batch;
+
+// Bounded blocking queue; NULL marks the end of the stream
+typedef struct {
+    Batch *items[BATCHES + 1];
+    int head;
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+} Queue;
+
+typedef struct {
+    FILE *text;
+    const unsigned char *map;
+    size_t mapSize;
+    int binary;
+
+    // Bytes read from a pipe to look for the binary header
+    unsigned char prefix[8];
+    int prefixLength;
+    int prefixUsed;
+
+    int solve;
+    int threads;
+
+    Queue freeQueue;
+    Queue solveQueue;
+    Queue writeQueue;
+
+    long systems;
+    int failed;
+} Stream;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void queue_init(Queue *q)
+{
+    q->head = 0;
+    q->count = 0;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->notEmpty, NULL);
+    pthread_cond_init(&q->notFull, NULL);
+}
+
+static void queue_destroy(Queue *q)
+{
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->notEmpty);
+    pthread_cond_destroy(&q->notFull);
+}
+
+static void queue_push(Queue *q, Batch *batch)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == BATCHES + 1)
+    {
+        pthread_cond_wait(&q->notFull, &q->lock);
+    }
+    q->items[(q->head + q->count) % (BATCHES + 1)] = batch;
+    q->count++;
+    pthread_cond_signal(&q->notEmpty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static Batch *queue_pop(Queue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0)
+    {
+        pthread_cond_wait(&q->notEmpty, &q->lock);
+    }
+    Batch *batch = q->items[q->head];
+    q->head = (q->head + 1) % (BATCHES + 1);
+    q->count--;
+    pthread_cond_signal(&q->notFull);
+    pthread_mutex_unlock(&q->lock);
+    return batch;
+}
+
+// Makes room for one more system of the given size. A batch only grows past
+// BATCH_CELLS when a single system needs it. Returns 1 when there is room, 0
+// when the system needs a new batch and -1 when it cannot be allocated.
+static int batch_reserve(Batch *batch, long cells)
+{
+    if (batch->count == BATCH_SYSTEMS)
+    {
+        return 0;
+    }
+    if (batch->used + cells > batch->capacity)
+    {
+        if (batch->count > 0)
+        {
+            return 0;
+        }
+        Complex *grown = (Complex *) realloc(batch->cells, sizeof(Complex) * cells);
+        if (grown == NULL)
+        {
+            return -1;
+        }
+        batch->cells = grown;
+        batch->capacity = cells;
+    }
+    return 1;
+}
+
+// Hands the current batch on if the next system does not fit, leaving the
+// batch to fill in *batch. Returns 0 when there is no memory for the system.
+static int batch_for(Stream *s, Batch **batch, long cells)
+{
+    int room = batch_reserve(*batch, cells);
+    if (room == 0)
+    {
+        queue_push(&s->solveQueue, *batch);
+        *batch = queue_pop(&s->freeQueue);
+        (*batch)->count = 0;
+        (*batch)->used = 0;
+        room = batch_reserve(*batch, cells);
+    }
+    if (room < 0)
+    {
+        fprintf(stderr, "cmat: system %ld: out of memory for %ld cells\n", s->systems + 1, cells);
+        return 0;
+    }
+    return 1;
+}
+
+static int check_shape(const Stream *s, long rows, long cols)
+{
+    if (rows < 1 || cols < 1 || rows > MAX_DIMENSION || cols > MAX_DIMENSION)
+    {
+        fprintf(stderr, "cmat: system %ld: rows and cols must be 1 to %d\n", s->systems + 1, MAX_DIMENSION);
+        return 0;
+    }
+    return 1;
+}
+
+static Complex *batch_add(Batch *batch, int rows, int cols)
+{
+    Shape *shape = &batch->shapes[batch->count++];
+    shape->rows = rows;
+    shape->cols = cols;
+    shape->offset = batch->used;
+    shape->text = NULL;
+    batch->used += (long) rows * cols;
+    return &batch->cells[shape->offset];
+}
+
+// Takes back the last batch_add, for a system that turned out incomplete
+static void batch_remove_last(Batch *batch)
+{
+    batch->count--;
+    batch->used = batch->shapes[batch->count].offset;
+}
+
+static int is_space(int c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int next_char(Stream *s)
+{
+    if (s->prefixUsed < s->prefixLength)
+    {
+        return s->prefix[s->prefixUsed++];
+    }
+    return getc_unlocked(s->text);
+}
+
+// Returns 1 for a token, 0 at the end of the input and -1 for a token too
+// long for TOKEN_SIZE
+static int read_token(Stream *s, char *token)
+{
+    int c;
+    do
+    {
+        c = next_char(s);
+    } while (is_space(c));
+
+    int len = 0;
+    while (c != EOF && !is_space(c))
+    {
+        if (len < TOKEN_SIZE - 1)
+        {
+            token[len] = (char) c;
+        }
+        len++;
+        c = next_char(s);
+    }
+    if (len >= TOKEN_SIZE)
+    {
+        return -1;
+    }
+    token[len] = 0;
+    return len > 0;
+}
+
+// Finds the next token in [p, end), copying it to token when that is not
+// NULL. Returns the position after it, or NULL when there is none or it is
+// too long for TOKEN_SIZE.
+static const char *next_token(const char *p, const char *end, char *token)
+{
+    while (p < end && is_space(*p))
+    {
+        p++;
+    }
+    if (p == end)
+    {
+        return NULL;
+    }
+
+    const char *start = p;
+    while (p < end && !is_space(*p))
+    {
+        p++;
+    }
+    if (p - start >= TOKEN_SIZE)
+    {
+        return NULL;
+    }
+    if (token != NULL)
+    {
+        memcpy(token, start, p - start);
+        token[p - start] = 0;
+    }
+    return p;
+}
+
+static int read_text(Stream *s, Batch **batch)
+{
+    char token[TOKEN_SIZE];
+    int got;
+
+    while ((got = read_token(s, token)) != 0)
+    {
+        const long rows = got > 0 ? strtol(token, NULL, 10) : 0;
+        const long cols = got > 0 && read_token(s, token) > 0 ? strtol(token, NULL, 10) : 0;
+        if (!check_shape(s, rows, cols) || !batch_for(s, batch, rows * cols))
+        {
+            return 0;
+        }
+
+        Complex *cells = batch_add(*batch, (int) rows, (int) cols);
+        for (long k = 0; k < rows * cols; k++)
+        {
+            got = read_token(s, token);
+            if (got <= 0)
+            {
+                if (got < 0)
+                {
+                    fprintf(stderr, "cmat: system %ld: cell longer than %d characters\n", s->systems + 1,
+                            TOKEN_SIZE - 1);
+                } else
+                {
+                    fprintf(stderr, "cmat: system %ld: expected %ld cells\n", s->systems + 1, rows * cols);
+                }
+                batch_remove_last(*batch);
+                return 0;
+            }
+            cells[k] = parse_complex(token);
+        }
+        s->systems++;
+    }
+    return 1;
+}
+
+// Splits mapped text into systems without parsing the cells; that is left to
+// solve_systems, so that it does not hold up the reader
+static int read_text_map(Stream *s, Batch **batch)
+{
+    const char *p = (const char *) s->map;
+    const char *end = p + s->mapSize;
+    char token[TOKEN_SIZE];
+
+    while (p < end)
+    {
+        // Only whitespace left
+        const char *next = p;
+        while (next < end && is_space(*next))
+        {
+            next++;
+        }
+        if (next == end)
+        {
+            break;
+        }
+
+        p = next_token(p, end, token);
+        const long rows = p != NULL ? strtol(token, NULL, 10) : 0;
+        p = p != NULL ? next_token(p, end, token) : NULL;
+        const long cols = p != NULL ? strtol(token, NULL, 10) : 0;
+        if (!check_shape(s, rows, cols))
+        {
+            return 0;
+        }
+
+        const char *text = p;
+        for (long k = 0; k < rows * cols && p != NULL; k++)
+        {
+            p = next_token(p, end, NULL);
+        }
+        if (p == NULL)
+        {
+            fprintf(stderr, "cmat: system %ld: expected %ld cells of at most %d characters\n", s->systems + 1,
+                    rows * cols, TOKEN_SIZE - 1);
+            return 0;
+        }
+
+        if (!batch_for(s, batch, rows * cols))
+        {
+            return 0;
+        }
+        batch_add(*batch, (int) rows, (int) cols);
+        (*batch)->shapes[(*batch)->count - 1].text = text;
+        s->systems++;
+    }
+    return 1;
+}
+
+// Binary from a pipe, once the header has been read into prefix
+static int read_binary_stream(Stream *s, Batch **batch)
+{
+    uint16_t size[2];
+    size_t got;
+
+    while ((got = fread(size, 1, sizeof(size), s->text)) > 0)
+    {
+        const long cells = (long) size[0] * size[1];
+        if (got < sizeof(size))
+        {
+            fprintf(stderr, "cmat: system %ld: truncated header\n", s->systems + 1);
+            return 0;
+        }
+        if (!check_shape(s, size[0], size[1]) || !batch_for(s, batch, cells))
+        {
+            return 0;
+        }
+
+        Complex *target = batch_add(*batch, size[0], size[1]);
+        if (fread(target, sizeof(Complex), cells, s->text) != (size_t) cells)
+        {
+            fprintf(stderr, "cmat: system %ld: truncated matrix\n", s->systems + 1);
+            batch_remove_last(*batch);
+            return 0;
+        }
+        s->systems++;
+    }
+    return 1;
+}
+
+static int read_binary(Stream *s, Batch **batch)
+{
+    size_t pos = 8;
+
+    while (pos < s->mapSize)
+    {
+        uint16_t size[2];
+        if (pos + sizeof(size) > s->mapSize)
+        {
+            fprintf(stderr, "cmat: system %ld: truncated header\n", s->systems + 1);
+            return 0;
+        }
+        memcpy(size, s->map + pos, sizeof(size));
+        pos += sizeof(size);
+
+        const long cells = (long) size[0] * size[1];
+        if (!check_shape(s, size[0], size[1]))
+        {
+            return 0;
+        }
+        if (pos + sizeof(Complex) * cells > s->mapSize)
+        {
+            fprintf(stderr, "cmat: system %ld: truncated matrix\n", s->systems + 1);
+            return 0;
+        }
+        if (!batch_for(s, batch, cells))
+        {
+            return 0;
+        }
+        memcpy(batch_add(*batch, size[0], size[1]), s->map + pos, sizeof(Complex) * cells);
+        pos += sizeof(Complex) * cells;
+        s->systems++;
+    }
+    return 1;
+}
+
+static void *reader_main(void *arg)
+{
+    Stream *s = (Stream *) arg;
+    Batch *batch = queue_pop(&s->freeQueue);
+    batch->count = 0;
+    batch->used = 0;
+
+    int ok;
+    if (s->map != NULL)
+    {
+        ok = s->binary ? read_binary(s, &batch) : read_text_map(s, &batch);
+    } else
+    {
+        ok = s->binary ? read_binary_stream(s, &batch) : read_text(s, &batch);
+    }
+    if (!ok)
+    {
+        s->failed = 1;
+    }
+
+    if (batch->count > 0)
+    {
+        queue_push(&s->solveQueue, batch);
+    } else
+    {
+        queue_push(&s->freeQueue, batch);
+    }
+    queue_push(&s->solveQueue, NULL);
+    return NULL;
+}
+
+typedef struct {
+    const Stream *s;
+    Batch *batch;
+} SolveTask;
+
+// Parses the cells still in text and solves the systems too small for the
+// blocked path, one system per iteration
+static void solve_systems(void *ctx, int worker, long begin, long end)
+{
+    const SolveTask *task = (const SolveTask *) ctx;
+    (void) worker;
+
+    for (long k = begin; k < end; k++)
+    {
+        const Shape *shape = &task->batch->shapes[k];
+        Complex *cells = &task->batch->cells[shape->offset];
+        char token[TOKEN_SIZE];
+
+        if (shape->text != NULL)
+        {
+            const char *p = shape->text;
+            const char *textEnd = (const char *) task->s->map + task->s->mapSize;
+            for (long c = 0; c < (long) shape->rows * shape->cols; c++)
+            {
+                p = next_token(p, textEnd, token);
+                cells[c] = parse_complex(token);
+            }
+        }
+        if (task->s->solve && shape->rows < BLOCKED_MIN_ROWS)
+        {
+            complex_rref_inplace(shape->rows, shape->cols, cells);
+        }
+    }
+}
+
+static void *solver_main(void *arg)
+{
+    Stream *s = (Stream *) arg;
+    Pool *pool = pool_create(s->threads);
+    Batch *batch;
+
+    while ((batch = queue_pop(&s->solveQueue)) != NULL)
+    {
+        SolveTask task = {s, batch};
+        pool_run(pool, batch->count, SYSTEMS_GRAIN, solve_systems, &task);
+
+        // Large systems use the whole pool each
+        for (int k = 0; s->solve && k < batch->count; k++)
+        {
+            const Shape *shape = &batch->shapes[k];
+            if (shape->rows >= BLOCKED_MIN_ROWS)
+            {
+                complex_rref_blocked(pool, shape->rows, shape->cols, &batch->cells[shape->offset]);
+            }
+        }
+        queue_push(&s->writeQueue, batch);
+    }
+    queue_push(&s->writeQueue, NULL);
+
+    pool_destroy(pool);
+    return NULL;
+}
+
+// Fixed-point formatting for the text writer; snprintf per number would make
+// the writer the slowest stage. Values too large for 64-bit scaling still go
+// through snprintf, which PART_TEXT_SIZE always has room for.
+static char *format_fixed(char *p, float value, int precision)
+{
+    static const long long powers[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+                                       1000000000};
+    const double magnitude = fabs((double) value) * powers[precision];
+
+    if (!(magnitude < 9e15))
+    {
+        const int len = snprintf(p, PART_TEXT_SIZE, "%.*f", precision, value);
+        return p + (len < PART_TEXT_SIZE ? len : PART_TEXT_SIZE - 1);
+    }
+
+    if (value < 0)
+    {
+        *p++ = '-';
+    }
+
+    const long long scaled = llrint(magnitude);
+    long long whole = scaled / powers[precision];
+    char digits[24];
+    int len = 0;
+    do
+    {
+        digits[len++] = (char) ('0' + whole % 10);
+        whole /= 10;
+    } while (whole > 0);
+    while (len > 0)
+    {
+        *p++ = digits[--len];
+    }
+
+    if (precision > 0)
+    {
+        long long frac = scaled % powers[precision];
+        *p++ = '.';
+        for (int k = precision - 1; k >= 0; k--)
+        {
+            p[k] = (char) ('0' + frac % 10);
+            frac /= 10;
+        }
+        p += precision;
+    }
+    return p;
+}
+
+// Same layout as parse_complex_number
+static char *format_cell(char *p, Complex z, int precision)
+{
+    if (z.r != 0)
+    {
+        p = format_fixed(p, z.r, precision);
+    }
+    if (z.i < 0 || (z.i > 0 && z.r == 0))
+    {
+        p = format_fixed(p, z.i, precision);
+        *p++ = 'i';
+    } else if (z.i > 0 && z.r != 0)
+    {
+        *p++ = '+';
+        p = format_fixed(p, z.i, precision);
+        *p++ = 'i';
+    }
+    if (z.r == 0 && z.i == 0)
+    {
+        *p++ = '0';
+    }
+    return p;
+}
+
+static void write_text(FILE *out, const Batch *batch, int precision, char **line, size_t *lineSize)
+{
+    for (int k = 0; k < batch->count; k++)
+    {
+        const Shape *shape = &batch->shapes[k];
+        const Complex *cells = &batch->cells[shape->offset];
+
+        const size_t needed = (size_t) shape->cols * CELL_TEXT_SIZE;
+        if (needed > *lineSize)
+        {
+            *line = (char *) realloc(*line, needed);
+            *lineSize = needed;
+        }
+
+        fprintf(out, "%d %d\n", shape->rows, shape->cols);
+        for (int i = 0; i < shape->rows; i++)
+        {
+            char *p = *line;
+            for (int j = 0; j < shape->cols; j++)
+            {
+                p = format_cell(p, cells[i * shape->cols + j], precision);
+                *p++ = j == shape->cols - 1 ? '\n' : ' ';
+            }
+            fwrite(*line, 1, p - *line, out);
+        }
+    }
+}
+
+static void write_binary(FILE *out, const Batch *batch)
+{
+    for (int k = 0; k < batch->count; k++)
+    {
+        const Shape *shape = &batch->shapes[k];
+        const uint16_t size[2] = {(uint16_t) shape->rows, (uint16_t) shape->cols};
+        fwrite(size, sizeof(size), 1, out);
+        fwrite(&batch->cells[shape->offset], sizeof(Complex), (size_t) shape->rows * shape->cols, out);
+    }
+}
+
+static int is_binary_header(const unsigned char *header)
+{
+    uint32_t version;
+    memcpy(&version, header + 4, sizeof(version));
+    return memcmp(header, BINARY_MAGIC, 4) == 0 && version == BINARY_VERSION;
+}
+
+// Maps input when it is a regular file; otherwise reads it as a stream,
+// looking at its first bytes to tell binary from text
+static int open_input(Stream *s, const char *path)
+{
+    const int useStdin = path == NULL || strcmp(path, "-") == 0;
+    const int fd = useStdin ? STDIN_FILENO : open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        perror(useStdin ? "stdin" : path);
+        return 0;
+    }
+
+    if (S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            s->map = (const unsigned char *) map;
+            s->mapSize = st.st_size;
+            s->binary = st.st_size >= 8 && is_binary_header(s->map);
+            if (!useStdin)
+            {
+                close(fd);
+            }
+            return 1;
+        }
+    }
+
+    s->text = useStdin ? stdin : fdopen(fd, "r");
+    if (s->text == NULL)
+    {
+        perror(path);
+        return 0;
+    }
+
+    s->prefixLength = (int) fread(s->prefix, 1, sizeof(s->prefix), s->text);
+    if (s->prefixLength == (int) sizeof(s->prefix) && is_binary_header(s->prefix))
+    {
+        s->binary = 1;
+        s->prefixUsed = s->prefixLength;
+    }
+    return 1;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: cmat [-B] [-x] [-v] [-p precision] [-t threads] [input [output]]\n");
+}
+
+int main(int argc, char **argv)
+{
+    Stream s;
+    memset(&s, 0, sizeof(s));
+    s.solve = 1;
+    s.threads = 1;
+
+    int binaryOut = 0;
+    int verbose = 0;
+    int precision = 6;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "Bxvp:t:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'B':
+                binaryOut = 1;
+                break;
+            case 'x':
+                s.solve = 0;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'p':
+                precision = atoi(optarg);
+                if (precision < 0 || precision > 9)
+                {
+                    fprintf(stderr, "cmat: precision must be 0 to 9\n");
+                    return 1;
+                }
+                break;
+            case 't':
+                s.threads = atoi(optarg);
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    if (argc - optind > 2)
+    {
+        usage();
+        return 1;
+    }
+
+    if (!open_input(&s, optind < argc ? argv[optind] : NULL))
+    {
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (optind + 1 < argc && strcmp(argv[optind + 1], "-") != 0)
+    {
+        out = fopen(argv[optind + 1], "wb");
+        if (out == NULL)
+        {
+            perror(argv[optind + 1]);
+            return 1;
+        }
+    }
+    static char outBuffer[1 << 20];
+    setvbuf(out, outBuffer, _IOFBF, sizeof(outBuffer));
+
+    if (binaryOut)
+    {
+        const uint32_t version = BINARY_VERSION;
+        fwrite(BINARY_MAGIC, 4, 1, out);
+        fwrite(&version, sizeof(version), 1, out);
+    }
+
+    queue_init(&s.freeQueue);
+    queue_init(&s.solveQueue);
+    queue_init(&s.writeQueue);
+
+    Batch *batches = (Batch *) calloc(BATCHES, sizeof(Batch));
+    for (int k = 0; k < BATCHES; k++)
+    {
+        batches[k].cells = (Complex *) malloc(sizeof(Complex) * BATCH_CELLS);
+        batches[k].capacity = BATCH_CELLS;
+        queue_push(&s.freeQueue, &batches[k]);
+    }
+
+    const double start = now();
+
+    pthread_t reader;
+    pthread_t solver;
+    pthread_create(&reader, NULL, reader_main, &s);
+    pthread_create(&solver, NULL, solver_main, &s);
+
+    // The main thread writes
+    char *line = NULL;
+    size_t lineSize = 0;
+    Batch *batch;
+    while ((batch = queue_pop(&s.writeQueue)) != NULL)
+    {
+        if (binaryOut)
+        {
+            write_binary(out, batch);
+        } else
+        {
+            write_text(out, batch, precision, &line, &lineSize);
+        }
+        queue_push(&s.freeQueue, batch);
+    }
+
+    pthread_join(reader, NULL);
+    pthread_join(solver, NULL);
+    fflush(out);
+    free(line);
+
+    const double elapsed = now() - start;
+    if (verbose)
+    {
+        fprintf(stderr, "cmat: %ld systems in %.3f s (%.0f systems/s)\n", s.systems, elapsed, s.systems / elapsed);
+    }
+
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    if (s.map != NULL)
+    {
+        munmap((void *) s.map, s.mapSize);
+    }
+    if (s.text != NULL && s.text != stdin)
+    {
+        fclose(s.text);
+    }
+    for (int k = 0; k < BATCHES; k++)
+    {
+        free(batches[k].cells);
+    }
+    free(batches);
+    queue_destroy(&s.freeQueue);
+    queue_destroy(&s.solveQueue);
+    queue_destroy(&s.writeQueue);
+    return s.failed;
+}
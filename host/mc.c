@@ -0,0 +1,545 @@
+// Monte Carlo tolerance analysis: re-solves a nominal system with every cell
+// scaled by a random factor drawn from its tolerance, and reports streaming
+// statistics of each unknown.
+//
+// Input file, whitespace separated:
+//   rows cols                     (cols == rows + 1, last column is the RHS)
+//   rows * cols nominal cells     in calculator syntax, e.g. 10 -2.5 3-4i
+//   rows * cols tolerances        0 (fixed), u<pct> (uniform +-pct%) or
+//                                 n<pct> (normal, sigma = pct%)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "solver.h"
+#include "format.h"
+#include "pool.h"
+
+#define DEFAULT_SAMPLES 100000
+#define DEFAULT_BINS 20
+#define PILOT_SAMPLES 1024
+
+// Samples are accumulated in blocks of BLOCK_SAMPLES, each in sample order,
+// and the blocks are merged in index order, so the statistics do not depend
+// on which worker ran a block. WAVE_BLOCKS blocks are run between merges.
+#define BLOCK_SAMPLES 256
+#define WAVE_BLOCKS 1024
+
+typedef enum {
+    TOL_NONE,
+    TOL_UNIFORM,
+    TOL_NORMAL
+} TolKind;
+
+typedef struct {
+    TolKind kind;
+    float width;
+} Tolerance;
+
+// Running mean and sum of squared deviations (Welford)
+typedef struct {
+    long n;
+    double mean;
+    double m2;
+} Stats;
+
+// Per-worker counters and scratch, carved from one cache-line aligned block
+// and padded so that workers never write to a shared line. Integer counts
+// sum exactly, so they need no ordering.
+typedef struct {
+    long *hist;
+    long singular;
+    Complex *scratch;
+    void *block;
+    char pad[64];
+} WorkerState;
+
+typedef struct {
+    int rows;
+    int cols;
+    int bins;
+    uint64_t seed;
+    long offset;
+    const Complex *nominal;
+    const Tolerance *tolerance;
+    const float *histLow;
+    const float *histHigh;
+    WorkerState *workers;
+    // Re, im and |x| statistics of every block in the current wave, each
+    // block's 3 * rows entries starting on its own cache line
+    Stats *blockStats;
+    size_t blockStride;
+    long firstBlock;
+    long lastSample;
+} Analysis;
+
+typedef struct {
+    uint64_t state;
+    int hasSpare;
+    float spare;
+} Rng;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Every sample gets its own stream, so the samples do not depend on which
+// worker ran them or on the thread count
+static void rng_seed(Rng *rng, uint64_t seed, long sample)
+{
+    rng->state = seed ^ ((uint64_t) sample * 0xD1B54A32D192ED03ull);
+    splitmix64(&rng->state);
+    rng->hasSpare = 0;
+}
+
+static float rng_uniform(Rng *rng)
+{
+    return (splitmix64(&rng->state) >> 40) * (1.0f / 16777216.0f);
+}
+
+static float rng_normal(Rng *rng)
+{
+    if (rng->hasSpare)
+    {
+        rng->hasSpare = 0;
+        return rng->spare;
+    }
+
+    // Box-Muller
+    float u = rng_uniform(rng);
+    const float v = rng_uniform(rng);
+    if (u < 1e-30f)
+    {
+        u = 1e-30f;
+    }
+    const float radius = sqrtf(-2.0f * logf(u));
+    rng->spare = radius * sinf(6.2831853f * v);
+    rng->hasSpare = 1;
+    return radius * cosf(6.2831853f * v);
+}
+
+static void stats_add(Stats *s, double x)
+{
+    s->n++;
+    const double delta = x - s->mean;
+    s->mean += delta / s->n;
+    s->m2 += delta * (x - s->mean);
+}
+
+// Chan et al. pairwise combination
+static void stats_merge(Stats *into, const Stats *from)
+{
+    if (from->n == 0)
+    {
+        return;
+    }
+    const long n = into->n + from->n;
+    const double delta = from->mean - into->mean;
+    into->mean += delta * from->n / n;
+    into->m2 += from->m2 + delta * delta * ((double) into->n * from->n / n);
+    into->n = n;
+}
+
+static double stats_std(const Stats *s)
+{
+    return s->n > 1 ? sqrt(s->m2 / (s->n - 1)) : 0;
+}
+
+// Perturbs and solves one sample in the worker's scratch buffer. Returns 0
+// when the perturbed system is singular.
+static int solve_sample(const Analysis *a, Complex *scratch, long sample)
+{
+    const int cells = a->rows * a->cols;
+    Rng rng;
+    rng_seed(&rng, a->seed, sample);
+
+    for (int cell = 0; cell < cells; cell++)
+    {
+        float factor = 1;
+        switch (a->tolerance[cell].kind)
+        {
+            case TOL_UNIFORM:
+                factor += a->tolerance[cell].width * (2 * rng_uniform(&rng) - 1);
+                break;
+            case TOL_NORMAL:
+                factor += a->tolerance[cell].width * rng_normal(&rng);
+                break;
+            case TOL_NONE:
+                break;
+        }
+        scratch[cell] = c_scale(a->nominal[cell], factor);
+    }
+
+    return complex_rref_inplace(a->rows, a->cols, scratch) == a->rows;
+}
+
+static void bin_value(const Analysis *a, long *hist, int unknown, float value)
+{
+    const float low = a->histLow[unknown];
+    const float high = a->histHigh[unknown];
+    int bin;
+
+    // Bin 0 and bin bins + 1 collect values outside the range
+    if (value < low)
+    {
+        bin = 0;
+    } else if (value >= high)
+    {
+        bin = a->bins + 1;
+    } else
+    {
+        bin = 1 + (int) ((value - low) / (high - low) * a->bins);
+        if (bin > a->bins)
+        {
+            bin = a->bins;
+        }
+    }
+    hist[unknown * (a->bins + 2) + bin]++;
+}
+
+// stats holds re, im and |x| for each unknown, rows entries each
+static void accumulate(const Analysis *a, const Complex *scratch, Stats *stats, long *hist)
+{
+    for (int i = 0; i < a->rows; i++)
+    {
+        const Complex x = scratch[i * a->cols + a->cols - 1];
+        const float mag = c_abs(x);
+        stats_add(&stats[i], x.r);
+        stats_add(&stats[a->rows + i], x.i);
+        stats_add(&stats[2 * a->rows + i], mag);
+        if (hist != NULL)
+        {
+            bin_value(a, hist, i, mag);
+        }
+    }
+}
+
+static Stats *block_stats(const Analysis *a, long block)
+{
+    return (Stats *) ((char *) a->blockStats + block * a->blockStride);
+}
+
+// Runs blocks [begin, end) of the current wave
+static void run_blocks(void *ctx, int worker, long begin, long end)
+{
+    const Analysis *a = (const Analysis *) ctx;
+    WorkerState *w = &a->workers[worker];
+
+    for (long block = begin; block < end; block++)
+    {
+        Stats *stats = block_stats(a, block);
+        memset(stats, 0, sizeof(Stats) * 3 * a->rows);
+
+        const long first = a->offset + (a->firstBlock + block) * BLOCK_SAMPLES;
+        const long last = first + BLOCK_SAMPLES < a->lastSample ? first + BLOCK_SAMPLES : a->lastSample;
+        for (long sample = first; sample < last; sample++)
+        {
+            if (solve_sample(a, w->scratch, sample))
+            {
+                accumulate(a, w->scratch, stats, w->hist);
+            } else
+            {
+                w->singular++;
+            }
+        }
+    }
+}
+
+static size_t round_line(size_t size)
+{
+    return (size + 63) & ~(size_t) 63;
+}
+
+static void worker_init(WorkerState *w, int rows, int cols, int bins)
+{
+    const size_t hist = round_line(sizeof(long) * rows * (bins + 2));
+    const size_t scratch = round_line(sizeof(Complex) * rows * cols);
+
+    char *block = (char *) aligned_alloc(64, hist + scratch);
+    memset(block, 0, hist);
+
+    w->block = block;
+    w->hist = (long *) block;
+    w->scratch = (Complex *) (block + hist);
+    w->singular = 0;
+}
+
+static int parse_tolerance(const char *token, Tolerance *tol)
+{
+    tol->kind = TOL_NONE;
+    tol->width = 0;
+
+    if (token[0] == 'u' || token[0] == 'n')
+    {
+        tol->kind = token[0] == 'u' ? TOL_UNIFORM : TOL_NORMAL;
+        tol->width = strtof(token + 1, NULL) / 100;
+        return 1;
+    }
+    return strcmp(token, "0") == 0 || strcmp(token, "-") == 0;
+}
+
+static int load_system(const char *path, int *rows, int *cols, Complex **nominal, Tolerance **tolerance)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        perror(path);
+        return 0;
+    }
+
+    if (fscanf(file, "%d %d", rows, cols) != 2 || *rows < 1 || *cols != *rows + 1)
+    {
+        fprintf(stderr, "%s: expected 'rows cols' with cols == rows + 1\n", path);
+        fclose(file);
+        return 0;
+    }
+
+    const int cells = *rows * *cols;
+    *nominal = (Complex *) malloc(sizeof(Complex) * cells);
+    *tolerance = (Tolerance *) malloc(sizeof(Tolerance) * cells);
+
+    char token[64];
+    for (int cell = 0; cell < 2 * cells; cell++)
+    {
+        if (fscanf(file, "%63s", token) != 1)
+        {
+            fprintf(stderr, "%s: expected %d cells and %d tolerances\n", path, cells, cells);
+            fclose(file);
+            return 0;
+        }
+        if (cell < cells)
+        {
+            (*nominal)[cell] = parse_complex(token);
+        } else if (!parse_tolerance(token, &(*tolerance)[cell - cells]))
+        {
+            fprintf(stderr, "%s: bad tolerance '%s'\n", path, token);
+            fclose(file);
+            return 0;
+        }
+    }
+
+    fclose(file);
+    return 1;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-n samples] [-t threads] [-s seed] [-b bins] file\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    long samples = DEFAULT_SAMPLES;
+    int threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t seed = 1;
+    int bins = DEFAULT_BINS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:t:s:b:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                samples = atol(optarg);
+                break;
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'b':
+                bins = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc - 1 || samples < 1 || bins < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Analysis a;
+    Complex *nominal;
+    Tolerance *tolerance;
+    if (!load_system(argv[optind], &a.rows, &a.cols, &nominal, &tolerance))
+    {
+        return 1;
+    }
+    a.bins = bins;
+    a.seed = seed;
+    a.nominal = nominal;
+    a.tolerance = tolerance;
+
+    Pool *pool = pool_create(threads);
+    threads = pool_threads(pool);
+
+    // Everything a worker touches in the hot loop is allocated up front
+    const int rows = a.rows;
+    a.workers = (WorkerState *) aligned_alloc(64, round_line(sizeof(WorkerState) * threads));
+    for (int t = 0; t < threads; t++)
+    {
+        worker_init(&a.workers[t], rows, a.cols, bins);
+    }
+
+    // Statistics in sample order: re, im and |x| of each unknown
+    Stats *total = (Stats *) calloc(3 * rows, sizeof(Stats));
+    a.blockStride = round_line(sizeof(Stats) * 3 * rows);
+    a.blockStats = (Stats *) aligned_alloc(64, a.blockStride * WAVE_BLOCKS);
+
+    const double start = now();
+
+    // A short serial pilot fixes the histogram range of each |x|
+    const long pilot = samples < PILOT_SAMPLES ? samples : PILOT_SAMPLES;
+    float *histLow = (float *) malloc(sizeof(float) * rows);
+    float *histHigh = (float *) malloc(sizeof(float) * rows);
+    float *pilotMag = (float *) malloc(sizeof(float) * pilot * rows);
+    long pilotSolved = 0;
+    WorkerState *first = &a.workers[0];
+
+    for (int i = 0; i < rows; i++)
+    {
+        histLow[i] = INFINITY;
+        histHigh[i] = -INFINITY;
+    }
+    for (long sample = 0; sample < pilot; sample++)
+    {
+        if (!solve_sample(&a, first->scratch, sample))
+        {
+            first->singular++;
+            continue;
+        }
+        accumulate(&a, first->scratch, total, NULL);
+        for (int i = 0; i < rows; i++)
+        {
+            const float mag = c_abs(first->scratch[i * a.cols + a.cols - 1]);
+            pilotMag[pilotSolved * rows + i] = mag;
+            histLow[i] = fminf(histLow[i], mag);
+            histHigh[i] = fmaxf(histHigh[i], mag);
+        }
+        pilotSolved++;
+    }
+
+    for (int i = 0; i < rows; i++)
+    {
+        if (pilotSolved == 0)
+        {
+            histLow[i] = 0;
+            histHigh[i] = 1;
+        }
+        const float margin = fmaxf((histHigh[i] - histLow[i]) * 0.25f, 1e-6f * fmaxf(1, histHigh[i]));
+        histLow[i] = fmaxf(0, histLow[i] - margin);
+        histHigh[i] += margin;
+    }
+    a.histLow = histLow;
+    a.histHigh = histHigh;
+
+    for (long k = 0; k < pilotSolved; k++)
+    {
+        for (int i = 0; i < rows; i++)
+        {
+            bin_value(&a, first->hist, i, pilotMag[k * rows + i]);
+        }
+    }
+
+    a.offset = pilot;
+    a.lastSample = samples;
+    const long blocks = (samples - pilot + BLOCK_SAMPLES - 1) / BLOCK_SAMPLES;
+    for (a.firstBlock = 0; a.firstBlock < blocks; a.firstBlock += WAVE_BLOCKS)
+    {
+        const long count = blocks - a.firstBlock < WAVE_BLOCKS ? blocks - a.firstBlock : WAVE_BLOCKS;
+        pool_run(pool, count, 1, run_blocks, &a);
+        for (long block = 0; block < count; block++)
+        {
+            const Stats *stats = block_stats(&a, block);
+            for (int k = 0; k < 3 * rows; k++)
+            {
+                stats_merge(&total[k], &stats[k]);
+            }
+        }
+    }
+
+    const double elapsed = now() - start;
+
+    // Sum the per-worker counts into worker 0
+    for (int t = 1; t < threads; t++)
+    {
+        for (int k = 0; k < rows * (bins + 2); k++)
+        {
+            first->hist[k] += a.workers[t].hist[k];
+        }
+        first->singular += a.workers[t].singular;
+    }
+
+    printf("%ld samples, %d threads, %.3f s (%.0f samples/s), %ld singular\n\n", samples, threads, elapsed,
+           samples / elapsed, first->singular);
+
+    printf("%4s %13s %13s %13s %13s %13s %13s\n", "x", "mean re", "std re", "mean im", "std im", "mean |x|",
+           "std |x|");
+    for (int i = 0; i < rows; i++)
+    {
+        const Stats *re = &total[i];
+        const Stats *im = &total[rows + i];
+        const Stats *mag = &total[2 * rows + i];
+        printf("%4d %13.6g %13.6g %13.6g %13.6g %13.6g %13.6g\n", i + 1, re->mean, stats_std(re), im->mean,
+               stats_std(im), mag->mean, stats_std(mag));
+    }
+
+    for (int i = 0; i < rows; i++)
+    {
+        const long *hist = &first->hist[i * (bins + 2)];
+        long peak = 1;
+        for (int b = 0; b < bins + 2; b++)
+        {
+            if (hist[b] > peak)
+            {
+                peak = hist[b];
+            }
+        }
+
+        printf("\n|x%d|\n", i + 1);
+        printf("%13s %13s %9ld\n", "", "< low", hist[0]);
+        for (int b = 1; b <= bins; b++)
+        {
+            const float width = (histHigh[i] - histLow[i]) / bins;
+            char bar[41];
+            const int len = (int) (40 * hist[b] / peak);
+            memset(bar, '#', len);
+            bar[len] = 0;
+            printf("%13.6g %13.6g %9ld %s\n", histLow[i] + (b - 1) * width, histLow[i] + b * width, hist[b], bar);
+        }
+        printf("%13s %13s %9ld\n", "", "> high", hist[bins + 1]);
+    }
+
+    pool_destroy(pool);
+    for (int t = 0; t < threads; t++)
+    {
+        free(a.workers[t].block);
+    }
+    free(a.workers);
+    free(a.blockStats);
+    free(total);
+    free(pilotMag);
+    free(histLow);
+    free(histHigh);
+    free(nominal);
+    free(tolerance);
+    return 0;
+}
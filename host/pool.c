@@ -0,0 +1,212 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include "pool.h"
+
+// Padded so that neighbouring workers do not share a cache line
+typedef struct {
+    pthread_mutex_t lock;
+    long begin;
+    long end;
+    char pad[64];
+} Range;
+
+typedef struct {
+    Pool *pool;
+    int id;
+} Worker;
+
+struct Pool {
+    int threads;
+    pthread_t *ids;
+    Worker *workers;
+    Range *ranges;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long generation;
+    int running;
+    int stop;
+
+    PoolTask task;
+    void *ctx;
+    long grain;
+};
+
+static int take_own(Range *range, long grain, long *begin, long *end)
+{
+    pthread_mutex_lock(&range->lock);
+    const int found = range->begin < range->end;
+    if (found)
+    {
+        *begin = range->begin;
+        *end = range->end - range->begin > grain ? range->begin + grain : range->end;
+        range->begin = *end;
+    }
+    pthread_mutex_unlock(&range->lock);
+    return found;
+}
+
+static int steal(Pool *pool, int id)
+{
+    for (int k = 1; k < pool->threads; k++)
+    {
+        Range *victim = &pool->ranges[(id + k) % pool->threads];
+
+        pthread_mutex_lock(&victim->lock);
+        const long left = victim->end - victim->begin;
+        long begin = 0;
+        long end = 0;
+        if (left > 0)
+        {
+            begin = victim->end - (left + 1) / 2;
+            end = victim->end;
+            victim->end = begin;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (left > 0)
+        {
+            Range *own = &pool->ranges[id];
+            pthread_mutex_lock(&own->lock);
+            own->begin = begin;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void run_worker(Pool *pool, int id)
+{
+    long begin;
+    long end;
+
+    do
+    {
+        while (take_own(&pool->ranges[id], pool->grain, &begin, &end))
+        {
+            pool->task(pool->ctx, id, begin, end);
+        }
+    } while (steal(pool, id));
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *worker = (Worker *) arg;
+    Pool *pool = worker->pool;
+    unsigned long seen = 0;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->generation == seen && !pool->stop)
+        {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->stop)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_worker(pool, worker->id);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0)
+        {
+            pthread_cond_signal(&pool->done);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+Pool *pool_create(int threads)
+{
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+
+    Pool *pool = (Pool *) calloc(1, sizeof(Pool));
+    pool->threads = threads;
+    pool->ids = (pthread_t *) malloc(sizeof(pthread_t) * threads);
+    pool->workers = (Worker *) malloc(sizeof(Worker) * threads);
+    pool->ranges = (Range *) calloc(threads, sizeof(Range));
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_mutex_init(&pool->ranges[i].lock, NULL);
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+    }
+    for (int i = 1; i < threads; i++)
+    {
+        pthread_create(&pool->ids[i], NULL, worker_main, &pool->workers[i]);
+    }
+    return pool;
+}
+
+int pool_threads(const Pool *pool)
+{
+    return pool->threads;
+}
+
+void pool_run(Pool *pool, long count, long grain, PoolTask task, void *ctx)
+{
+    pool->task = task;
+    pool->ctx = ctx;
+    pool->grain = grain < 1 ? 1 : grain;
+
+    for (int i = 0; i < pool->threads; i++)
+    {
+        pool->ranges[i].begin = count * i / pool->threads;
+        pool->ranges[i].end = count * (i + 1) / pool->threads;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->running = pool->threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_worker(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0)
+    {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_destroy(Pool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 1; i < pool->threads; i++)
+    {
+        pthread_join(pool->ids[i], NULL);
+    }
+    for (int i = 0; i < pool->threads; i++)
+    {
+        pthread_mutex_destroy(&pool->ranges[i].lock);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->ids);
+    free(pool->workers);
+    free(pool->ranges);
+    free(pool);
+}
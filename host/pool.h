@@ -0,0 +1,24 @@
+#ifndef POOL_H
+#define POOL_H
+
+// Fixed set of worker threads running parallel loops over [0, count).
+// Each worker starts with an even share of the range and takes grain sized
+// pieces from its front; a worker that runs dry steals the back half of
+// another worker's remaining range.
+typedef struct Pool Pool;
+
+// Called with the worker index (0 is the thread that called pool_run) and a
+// piece [begin, end) of the range
+typedef void (*PoolTask)(void *ctx, int worker, long begin, long end);
+
+// threads counts the calling thread, so 1 runs everything inline
+Pool *pool_create(int threads);
+
+int pool_threads(const Pool *pool);
+
+// Runs task over [0, count) and returns once every piece is done
+void pool_run(Pool *pool, long count, long grain, PoolTask task, void *ctx);
+
+void pool_destroy(Pool *pool);
+
+#endif
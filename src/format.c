@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "format.h"
+
+Complex parse_complex(const char *str)
+{
+    float real = 0;
+    float imag = 0;
+    float container = 0;
+    int realPart = 1;
+    int negative = 0;
+    int decimal = 0;
+    // Place value of the last decimal digit, instead of a pow call per digit
+    double place = 1;
+
+    for (int i = 0; str[i] != 0; i++)
+    {
+        const char c = str[i];
+        if (c >= 48 && c < 58)
+        {
+            if (decimal)
+            {
+                place /= 10;
+                container = fabs(container) + (c - 48) * place;
+            } else
+            {
+                container = fabs(container * 10) + (c - 48);
+            }
+
+            if (negative)
+            {
+                container *= -1;
+            }
+        } else if (c == '-')
+        {
+            negative = 1;
+            if (realPart == 1)
+            {
+                real = container;
+            } else
+            {
+                imag = container;
+            }
+            decimal = 0;
+            realPart = 1;
+            container = 0;
+        } else if (c == '+')
+        {
+            if (realPart == 1)
+            {
+                real = container;
+            } else
+            {
+                imag = container;
+            }
+            negative = 0;
+            realPart = 1;
+            decimal = 0;
+            container = 0;
+        } else if (c == '.')
+        {
+            decimal = 1;
+            place = 1;
+        } else if (c == 'i')
+        {
+            realPart = 0;
+            if (!container)
+            {
+                container++;
+            }
+            imag = container;
+
+            container = 0;
+        }
+    }
+
+    if (realPart == 1 && container != 0)
+    {
+        real = container;
+    } else if (container != 0)
+    {
+        imag = container;
+    }
+
+    Complex complex = {real, imag};
+    return complex;
+}
+
+
+void parse_complex_number(float real, float imag, char *resultBuf, char *buf, int precision)
+{
+    if (real != 0)
+    {
+        sprintf(buf, "%.*f", precision, real);
+        strcat(resultBuf, buf);
+    }
+    if (imag < 0 || (imag > 0 && real == 0))
+    {
+        sprintf(buf, "%.*fi", precision, imag);
+        strcat(resultBuf, buf);
+    } else if (imag > 0 && real != 0)
+    {
+        sprintf(buf, "+%.*fi", precision, imag);
+        strcat(resultBuf, buf);
+    }
+    if (real == 0 && imag == 0)
+    {
+        sprintf(buf, "0");
+        strcpy(resultBuf, buf);
+    }
+}
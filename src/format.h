@@ -0,0 +1,11 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include "solver.h"
+
+// Parses one cell as typed on the calculator, e.g. "3", "-2.5", "4-3i", "i"
+Complex parse_complex(const char *str);
+
+void parse_complex_number(float real, float imag, char *resultBuf, char *buf, int precision);
+
+#endif
@@ -6,14 +6,12 @@
 #include <fatdrvce.h>
 #include <fileioc.h>
 #include <graphx.h>
+#include "solver.h"
+#include "format.h"
 
 #define SCREEN_WIDTH 320
 #define SCREEN_HEIGHT 240
 
-#define EPSILON 1e-6f
-
-#define MAX_ROWS 9
-#define MAX_COLS 9
 #define CELL_SIZE 32
 
 #define GRID_WIDTH 240
@@ -45,21 +43,11 @@ typedef enum {
     KEY_9 = 151
 } KeyCode;
 
-typedef struct {
-    float r;
-    float i;
-} Complex;
-
 typedef struct Pair {
     int x;
     int y;
 } Pair;
 
-float c_abs(Complex a)
-{
-    return sqrtf(a.r * a.r + a.i * a.i);
-}
-
 cplx_t floats_to_cplx(float real, float imag)
 {
     cplx_t res;
@@ -70,121 +58,6 @@ cplx_t floats_to_cplx(float real, float imag)
     return res;
 }
 
-Complex c_div(Complex a, Complex b)
-{
-    Complex res;
-    float denom = b.r * b.r + b.i * b.i;
-    res.r = (a.r * b.r + a.i * b.i) / denom;
-    res.i = (a.i * b.r - a.r * b.i) / denom;
-    return res;
-}
-
-Complex c_mul(Complex a, Complex b)
-{
-    Complex res;
-    res.r = a.r * b.r - a.i * b.i;
-    res.i = a.r * b.i + a.i * b.r;
-    return res;
-}
-
-Complex c_sub(Complex a, Complex b)
-{
-    Complex res;
-    res.r = a.r - b.r;
-    res.i = a.i - b.i;
-    return res;
-}
-
-Complex c_scale(Complex a, float s)
-{
-    Complex res;
-    res.r = a.r * s;
-    res.i = a.i * s;
-    return res;
-}
-
-Complex *complex_rref(int rows, int cols, const Complex *matrix)
-{
-    if (matrix == NULL)
-    {
-        return NULL;
-    }
-
-    Complex *A = (Complex *) malloc(sizeof(Complex) * rows * cols);
-
-    for (int i = 0; i < rows; i++)
-    {
-        for (int j = 0; j < cols; j++)
-        {
-            A[i * cols + j] = matrix[i * cols + j];
-        }
-    }
-
-    int lead = 0;
-
-    for (int r = 0; r < rows; r++)
-    {
-        if (cols <= lead)
-        {
-            break;
-        }
-
-        int i = r;
-
-        // Find pivot
-        while (c_abs(A[i * cols + lead]) < EPSILON)
-        {
-            i++;
-            if (rows == i)
-            {
-                i = r;
-                lead++;
-                if (cols == lead)
-                {
-                    return A;
-                }
-            }
-        }
-
-        // Swap rows
-        if (i != r)
-        {
-            for (int j = 0; j < cols; j++)
-            {
-                Complex temp = A[r * cols + j];
-                A[r * cols + j] = A[i * cols + j];
-                A[i * cols + j] = temp;
-            }
-        }
-
-        // Normalize row
-        Complex div = A[r * cols + lead];
-        if (c_abs(div) > EPSILON)
-        {
-            for (int j = 0; j < cols; j++)
-            {
-                A[r * cols + j] = c_div(A[r * cols + j], div);
-            }
-        }
-
-        // Eliminate other rows
-        for (int k = 0; k < rows; k++)
-        {
-            if (k != r)
-            {
-                Complex mul = A[k * cols + lead];
-                for (int j = 0; j < cols; j++)
-                {
-                    Complex term = c_mul(mul, A[r * cols + j]);
-                    A[k * cols + j] = c_sub(A[k * cols + j], term);
-                }
-            }
-        }
-        lead++;
-    }
-    return A;
-}
-
 void storeResults(Complex *solvedMatrix, int rows, int columns)
 {
     for (int i = 0; i < rows; i++)
@@ -237,120 +110,6 @@ int get_input_ptr(const char *str)
     return i;
 }
 
-Complex *parse_matrix(char ***matrix, int rows, int columns)
-{
-    Complex *parsedMatrix = (Complex *) malloc(sizeof(Complex) * rows * columns);
-
-    for (int row = 0; row < rows; row++)
-    {
-        for (int col = 0; col < columns; col++)
-        {
-            float real = 0;
-            float imag = 0;
-            float container = 0;
-            int realPart = 1;
-            int negative = 0;
-            int decimal = 0;
-
-            for (int i = 0; matrix[row][col][i] != 0; i++)
-            {
-                const char c = matrix[row][col][i];
-                if (c >= 48 && c < 58)
-                {
-                    if (decimal)
-                    {
-                        container = fabs(container) + (c - 48) * pow(10, -decimal);
-                        decimal++;
-                    } else
-                    {
-                        container = fabs(container * 10) + (c - 48);
-                    }
-
-                    if (negative)
-                    {
-                        container *= -1;
-                    }
-                } else if (c == '-')
-                {
-                    negative = 1;
-                    if (realPart == 1)
-                    {
-                        real = container;
-                    } else
-                    {
-                        imag = container;
-                    }
-                    decimal = 0;
-                    realPart = 1;
-                    container = 0;
-                } else if (c == '+')
-                {
-                    if (realPart == 1)
-                    {
-                        real = container;
-                    } else
-                    {
-                        imag = container;
-                    }
-                    negative = 0;
-                    realPart = 1;
-                    decimal = 0;
-                    container = 0;
-                } else if (c == '.')
-                {
-                    decimal = 1;
-                } else if (c == 'i')
-                {
-                    realPart = 0;
-                    if (!container)
-                    {
-                        container++;
-                    }
-                    imag = container;
-
-                    container = 0;
-                }
-            }
-
-            if (realPart == 1 && container != 0)
-            {
-                real = container;
-            } else if (container != 0)
-            {
-                imag = container;
-            }
-
-            Complex complex = {real, imag};
-            parsedMatrix[row * columns + col] = complex;
-        }
-    }
-    return parsedMatrix;
-}
-
-
-void parse_complex_number(float real, float imag, char *resultBuf, char *buf, int precision)
-{
-    if (real != 0)
-    {
-        sprintf(buf, "%.*f", precision, real);
-        strcat(resultBuf, buf);
-    }
-    if (imag < 0 || (imag > 0 && real == 0))
-    {
-        sprintf(buf, "%.*fi", precision, imag);
-        strcat(resultBuf, buf);
-    } else if (imag > 0 && real != 0)
-    {
-        sprintf(buf, "+%.*fi", precision, imag);
-        strcat(resultBuf, buf);
-    }
-    if (real == 0 && imag == 0)
-    {
-        sprintf(buf, "0");
-        strcpy(resultBuf, buf);
-    }
-}
-
 char ***serialize_matrix(Complex *matrix, int rows, int columns)
 {
     char ***serializedMatrix = (char ***) malloc(sizeof(char **) * rows);
@@ -419,8 +178,40 @@ void print_grid(const int rows, const int columns, char ***serializedMatrix, con
     }
 }
 
-void print_rref_ui(int rows, int columns, char ***serializedMatrix, Complex *solvedMatrix, bool inGrid,
-                   Pair gridCursor)
+void format_status(char *buf, SolvePath path, float residual)
+{
+    if (path == SOLVE_RREF)
+    {
+        strcpy(buf, "RREF");
+        return;
+    }
+
+    const char *label = "FULL SOLVE";
+    if (path == SOLVE_RANK_ONE)
+    {
+        label = "RANK-1 UPDATE";
+    } else if (path == SOLVE_REUSED)
+    {
+        label = "LU REUSED";
+    }
+    if (residual == 0)
+    {
+        sprintf(buf, "%s  RES 0", label);
+        return;
+    }
+
+    int exponent = (int) floorf(log10f(residual));
+    float mantissa = residual / powf(10, exponent);
+    if (mantissa >= 9.95f)
+    {
+        mantissa /= 10;
+        exponent++;
+    }
+    sprintf(buf, "%s  RES %.1fE%d", label, mantissa, exponent);
+}
+
+void print_rref_ui(int rows, int columns, char ***serializedMatrix, Complex *solvedMatrix, const char *status,
+                   bool inGrid, Pair gridCursor)
 {
     Pair gridOffset = {20, 30};
     char resultBuf[CELL_SIZE] = {};
@@ -431,6 +222,10 @@ void print_rref_ui(int rows, int columns, char ***serializedMatrix, Complex *sol
 
     print_grid(rows, columns, serializedMatrix, gridOffset, gridCursor, inGrid);
 
+    gfx_SetTextScale(1, 1);
+    gfx_PrintStringXY(status, 20, 12);
+    gfx_SetTextScale(2, 2);
+
     if (!inGrid)
     {
         gfx_FillRectangle(20, SCREEN_HEIGHT - 40, SCREEN_WIDTH - 30, 30);
@@ -451,10 +246,12 @@ void print_rref_ui(int rows, int columns, char ***serializedMatrix, Complex *sol
     gfx_BlitBuffer();
 }
 
-void print_rref_matrix(Complex *matrix, int rows, int columns)
+void print_rref_matrix(Complex *matrix, int rows, int columns, SolveCache *cache, const Factorization *partial)
 {
     gfx_FillScreen(255);
-    Complex *solvedMatrix = complex_rref(rows, columns, matrix);
+    float residual;
+    SolvePath path;
+    Complex *solvedMatrix = complex_solve_cached(cache, rows, columns, matrix, partial, &residual, &path);
     storeResults(solvedMatrix, rows, columns);
 
     if (solvedMatrix == NULL)
@@ -465,9 +262,12 @@ void print_rref_matrix(Complex *matrix, int rows, int columns)
 
     char ***serializedMatrix = serialize_matrix(solvedMatrix, rows, columns);
 
+    char status[CELL_SIZE];
+    format_status(status, path, residual);
+
     bool inGrid = 0;
     Pair gridCursor = {rows - 1, 0};
-    print_rref_ui(rows, columns, serializedMatrix, solvedMatrix, inGrid, gridCursor);
+    print_rref_ui(rows, columns, serializedMatrix, solvedMatrix, status, inGrid, gridCursor);
 
 
     uint16_t key = os_GetKey();
@@ -531,7 +331,7 @@ void print_rref_matrix(Complex *matrix, int rows, int columns)
                 }
             }
         }
-        print_rref_ui(rows, columns, serializedMatrix, solvedMatrix, inGrid, gridCursor);
+        print_rref_ui(rows, columns, serializedMatrix, solvedMatrix, status, inGrid, gridCursor);
         key = os_GetKey();
     }
 
@@ -575,6 +375,16 @@ void print_ui()
         }
     }
 
+    // Kept across RREF presses so that editing one cell after BACK does not
+    // need a full solve
+    SolveCache *cache = (SolveCache *) malloc(sizeof(SolveCache));
+    solve_cache_reset(cache);
+
+    // Cells are parsed as the cursor leaves them and the rows above the cursor
+    // are eliminated before waiting for the next key
+    Elimination *elimination = (Elimination *) malloc(sizeof(Elimination));
+    elimination_init(elimination);
+
     int inGrid = 0;
     int rref = 0;
     Pair cursor = {0, 0};
@@ -600,6 +410,9 @@ void print_ui()
     while (key != KEY_MODE && key != KEY_QUIT)
     {
         Pair gridOffset = {20, 60};
+        const int wasInGrid = inGrid;
+        const Pair editedCell = gridCursor;
+        const Pair previousGrid = grid;
 
         if (key >= KEY_0 && key <= KEY_9)
         {
@@ -655,8 +468,8 @@ void print_ui()
         {
             if (rref)
             {
-                Complex *parsedMatrix = parse_matrix(matrix, grid.x, grid.y);
-                print_rref_matrix(parsedMatrix, grid.x, grid.y);
+                Complex *parsedMatrix = elimination_matrix(elimination);
+                print_rref_matrix(parsedMatrix, grid.x, grid.y, cache, &elimination->f);
             } else if (!inGrid)
             {
                 if (cursor.x == 0)
@@ -763,6 +576,16 @@ void print_ui()
             }
         }
 
+        if (grid.x != previousGrid.x || grid.y != previousGrid.y)
+        {
+            elimination_resize(elimination, grid.x, grid.y);
+        }
+        if (wasInGrid && (!inGrid || editedCell.x != gridCursor.x || editedCell.y != gridCursor.y))
+        {
+            elimination_set(elimination, editedCell.x, editedCell.y,
+                            parse_complex(matrix[editedCell.x][editedCell.y]));
+        }
+
         gfx_FillScreen(255);
 
         print_grid(grid.x, grid.y, matrix, gridOffset, gridCursor, inGrid);
@@ -791,6 +614,16 @@ void print_ui()
 #endif
 
         gfx_BlitBuffer();
+
+        // os_GetKey blocks, so the elimination is done here, after the frame
+        // is shown and while the next key is being typed. A single edit to
+        // the last solved matrix is left to the rank-one update instead.
+        const int ready = rref ? grid.x : inGrid ? gridCursor.x : 0;
+        if (!solve_cache_covers(cache, elimination))
+        {
+            while (elimination_step(elimination, ready));
+        }
+
         key = os_GetKey();
     }
 
@@ -804,6 +637,8 @@ void print_ui()
         free(matrix[i]);
     }
     free(matrix);
+    free(cache);
+    free(elimination);
 }
 
 int main()
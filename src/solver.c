@@ -0,0 +1,617 @@
+#include <stdlib.h>
+#include <math.h>
+#include "solver.h"
+
+typedef struct {
+    long double r;
+    long double i;
+} LongComplex;
+
+float c_abs(Complex a)
+{
+    return sqrtf(a.r * a.r + a.i * a.i);
+}
+
+Complex c_div(Complex a, Complex b)
+{
+    Complex res;
+    float denom = b.r * b.r + b.i * b.i;
+    res.r = (a.r * b.r + a.i * b.i) / denom;
+    res.i = (a.i * b.r - a.r * b.i) / denom;
+    return res;
+}
+
+Complex c_mul(Complex a, Complex b)
+{
+    Complex res;
+    res.r = a.r * b.r - a.i * b.i;
+    res.i = a.r * b.i + a.i * b.r;
+    return res;
+}
+
+Complex c_sub(Complex a, Complex b)
+{
+    Complex res;
+    res.r = a.r - b.r;
+    res.i = a.i - b.i;
+    return res;
+}
+
+Complex c_scale(Complex a, float s)
+{
+    Complex res;
+    res.r = a.r * s;
+    res.i = a.i * s;
+    return res;
+}
+
+int complex_rref_inplace(int rows, int cols, Complex *A)
+{
+    int lead = 0;
+    int pivots = 0;
+
+    for (int r = 0; r < rows; r++)
+    {
+        if (cols <= lead)
+        {
+            break;
+        }
+
+        int i = r;
+
+        // Find pivot
+        while (c_abs(A[i * cols + lead]) < EPSILON)
+        {
+            i++;
+            if (rows == i)
+            {
+                i = r;
+                lead++;
+                if (cols == lead)
+                {
+                    return pivots;
+                }
+            }
+        }
+
+        if (lead < cols - 1)
+        {
+            pivots++;
+        }
+
+        // Swap rows
+        if (i != r)
+        {
+            for (int j = 0; j < cols; j++)
+            {
+                Complex temp = A[r * cols + j];
+                A[r * cols + j] = A[i * cols + j];
+                A[i * cols + j] = temp;
+            }
+        }
+
+        // Normalize row
+        Complex div = A[r * cols + lead];
+        if (c_abs(div) > EPSILON)
+        {
+            for (int j = 0; j < cols; j++)
+            {
+                A[r * cols + j] = c_div(A[r * cols + j], div);
+            }
+        }
+
+        // Eliminate other rows
+        for (int k = 0; k < rows; k++)
+        {
+            if (k != r)
+            {
+                Complex mul = A[k * cols + lead];
+                for (int j = 0; j < cols; j++)
+                {
+                    Complex term = c_mul(mul, A[r * cols + j]);
+                    A[k * cols + j] = c_sub(A[k * cols + j], term);
+                }
+            }
+        }
+        lead++;
+    }
+    return pivots;
+}
+
+Complex *complex_rref(int rows, int cols, const Complex *matrix)
+{
+    if (matrix == NULL)
+    {
+        return NULL;
+    }
+
+    Complex *A = (Complex *) malloc(sizeof(Complex) * rows * cols);
+
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            A[i * cols + j] = matrix[i * cols + j];
+        }
+    }
+
+    complex_rref_inplace(rows, cols, A);
+    return A;
+}
+
+void lu_reset(Factorization *f, int size)
+{
+    f->size = size;
+    f->rows = 0;
+}
+
+int lu_append_row(Factorization *f, const Complex *row)
+{
+    const int r = f->rows;
+    Complex *u = f->U[r];
+
+    for (int j = 0; j < f->size; j++)
+    {
+        u[j] = row[j];
+    }
+
+    // Eliminate the pivot columns of the rows already factored
+    for (int k = 0; k < r; k++)
+    {
+        const int p = f->pivot[k];
+        Complex mul = c_div(u[p], f->U[k][p]);
+        f->L[r][k] = mul;
+        for (int j = 0; j < f->size; j++)
+        {
+            u[j] = c_sub(u[j], c_mul(mul, f->U[k][j]));
+        }
+        u[p].r = 0;
+        u[p].i = 0;
+    }
+
+    // Pick the largest remaining entry as this row's pivot
+    int lead = 0;
+    float best = 0;
+    for (int j = 0; j < f->size; j++)
+    {
+        const float mag = c_abs(u[j]);
+        if (mag > best)
+        {
+            best = mag;
+            lead = j;
+        }
+    }
+
+    if (best < EPSILON)
+    {
+        return 0;
+    }
+
+    f->pivot[r] = lead;
+    f->L[r][r].r = 1;
+    f->L[r][r].i = 0;
+    f->rows++;
+    return 1;
+}
+
+void lu_solve(const Factorization *f, const Complex *b, Complex *x)
+{
+    Complex y[MAX_ROWS];
+
+    // Forward substitution with the unit lower factor
+    for (int i = 0; i < f->size; i++)
+    {
+        y[i] = b[i];
+        for (int k = 0; k < i; k++)
+        {
+            y[i] = c_sub(y[i], c_mul(f->L[i][k], y[k]));
+        }
+    }
+
+    // Back substitution; row i only has entries in its own pivot column and
+    // in the pivot columns of the rows after it
+    for (int i = f->size - 1; i >= 0; i--)
+    {
+        Complex sum = y[i];
+        for (int k = i + 1; k < f->size; k++)
+        {
+            sum = c_sub(sum, c_mul(f->U[i][f->pivot[k]], x[f->pivot[k]]));
+        }
+        x[f->pivot[i]] = c_div(sum, f->U[i][f->pivot[i]]);
+    }
+}
+
+void lu_solve_updated(const Factorization *f, const RankOne *update, const Complex *b, Complex *x)
+{
+    lu_solve(f, b, x);
+    if (update == NULL)
+    {
+        return;
+    }
+
+    // x -= u * delta * x[col] / denom
+    const Complex t = c_div(c_mul(update->delta, x[update->col]), update->denom);
+    for (int i = 0; i < f->size; i++)
+    {
+        x[i] = c_sub(x[i], c_mul(t, update->u[i]));
+    }
+}
+
+// Residual b - Ax in long double, returning its infinity norm
+static long double long_residual(int rows, int cols, const Complex *matrix, const LongComplex *x, Complex *residual)
+{
+    long double norm = 0;
+
+    for (int i = 0; i < rows; i++)
+    {
+        LongComplex sum;
+        sum.r = matrix[i * cols + cols - 1].r;
+        sum.i = matrix[i * cols + cols - 1].i;
+
+        for (int j = 0; j < cols - 1; j++)
+        {
+            const long double ar = matrix[i * cols + j].r;
+            const long double ai = matrix[i * cols + j].i;
+            sum.r -= ar * x[j].r - ai * x[j].i;
+            sum.i -= ar * x[j].i + ai * x[j].r;
+        }
+
+        residual[i].r = (float) sum.r;
+        residual[i].i = (float) sum.i;
+
+        const long double mag = sqrtl(sum.r * sum.r + sum.i * sum.i);
+        if (mag > norm)
+        {
+            norm = mag;
+        }
+    }
+    return norm;
+}
+
+float complex_refine(int rows, int cols, const Complex *matrix, const Factorization *f, const RankOne *update,
+                     Complex *x, int steps)
+{
+    Complex b[MAX_ROWS] = {};
+    Complex r[MAX_ROWS];
+    Complex d[MAX_ROWS];
+    LongComplex xl[MAX_ROWS] = {};
+    LongComplex best[MAX_ROWS];
+
+    for (int i = 0; i < rows; i++)
+    {
+        b[i] = matrix[i * cols + cols - 1];
+    }
+
+    lu_solve_updated(f, update, b, x);
+    for (int i = 0; i < rows; i++)
+    {
+        xl[i].r = x[i].r;
+        xl[i].i = x[i].i;
+        best[i] = xl[i];
+    }
+
+    long double bestNorm = long_residual(rows, cols, matrix, xl, r);
+
+    // Solve for the correction in single precision and accumulate it in long
+    // double, keeping the iterate with the smallest residual
+    for (int step = 0; step < steps && bestNorm > 0; step++)
+    {
+        lu_solve_updated(f, update, r, d);
+        for (int i = 0; i < rows; i++)
+        {
+            xl[i].r += d[i].r;
+            xl[i].i += d[i].i;
+        }
+
+        const long double norm = long_residual(rows, cols, matrix, xl, r);
+        if (norm >= bestNorm)
+        {
+            break;
+        }
+
+        bestNorm = norm;
+        for (int i = 0; i < rows; i++)
+        {
+            best[i] = xl[i];
+        }
+    }
+
+    // Report the residual of the float x that is returned, not of the long
+    // double iterate; rounding to float is what limits the accuracy
+    for (int i = 0; i < rows; i++)
+    {
+        x[i].r = (float) best[i].r;
+        x[i].i = (float) best[i].i;
+        best[i].r = x[i].r;
+        best[i].i = x[i].i;
+    }
+    return (float) long_residual(rows, cols, matrix, best, r);
+}
+
+// Lays a solution out the way complex_rref would: [I | x]
+static Complex *solution_matrix(int rows, int cols, const Complex *x)
+{
+    Complex *A = (Complex *) malloc(sizeof(Complex) * rows * cols);
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols - 1; j++)
+        {
+            A[i * cols + j].r = i == j;
+            A[i * cols + j].i = 0;
+        }
+        A[i * cols + cols - 1] = x[i];
+    }
+    return A;
+}
+
+// Factors and solves a square system with refinement, starting from partial
+// when it is given. Returns 0 when the system is not square or is singular.
+static int solve_full(int rows, int cols, const Complex *matrix, const Factorization *partial, Factorization *f,
+                      Complex *x, float *residual)
+{
+    if (rows != cols - 1)
+    {
+        return 0;
+    }
+
+    if (partial != NULL && partial->size == rows)
+    {
+        *f = *partial;
+    } else
+    {
+        lu_reset(f, rows);
+    }
+    for (int i = f->rows; i < rows; i++)
+    {
+        if (!lu_append_row(f, &matrix[i * cols]))
+        {
+            return 0;
+        }
+    }
+
+    *residual = complex_refine(rows, cols, matrix, f, NULL, x, REFINE_STEPS);
+    return 1;
+}
+
+Complex *complex_solve(int rows, int cols, const Complex *matrix, float *residual)
+{
+    Factorization f;
+    Complex x[MAX_ROWS];
+
+    *residual = -1;
+
+    if (matrix == NULL || !solve_full(rows, cols, matrix, NULL, &f, x, residual))
+    {
+        return complex_rref(rows, cols, matrix);
+    }
+    return solution_matrix(rows, cols, x);
+}
+
+void solve_cache_reset(SolveCache *cache)
+{
+    cache->rows = 0;
+    cache->cols = 0;
+    cache->factored = 0;
+    cache->updated = 0;
+}
+
+// max_i |b_i| + sum_j |a_ij||x_j|, what the residual is measured against
+static float residual_scale(int rows, int cols, const Complex *matrix, const Complex *x)
+{
+    float scale = 0;
+    for (int i = 0; i < rows; i++)
+    {
+        float sum = c_abs(matrix[i * cols + cols - 1]);
+        for (int j = 0; j < cols - 1; j++)
+        {
+            sum += c_abs(matrix[i * cols + j]) * c_abs(x[j]);
+        }
+        if (sum > scale)
+        {
+            scale = sum;
+        }
+    }
+    return scale;
+}
+
+// Tries to solve matrix from the cached factorization, given that it differs
+// from the cached matrix only in cell (row, col). Returns 0 when that is not
+// possible or not numerically safe.
+static int solve_rank_one(SolveCache *cache, const Complex *matrix, int row, int col, Complex *x, float *residual)
+{
+    const int rows = cache->rows;
+    const int cols = cache->cols;
+    RankOne update = cache->update;
+    const Complex change = c_sub(matrix[row * cols + col], cache->matrix[row * cols + col]);
+
+    // The right-hand side does not touch the factorization at all
+    if (col != cols - 1)
+    {
+        if (!cache->updated)
+        {
+            Complex e[MAX_ROWS] = {};
+            e[row].r = 1;
+            lu_solve(&cache->f, e, update.u);
+            update.row = row;
+            update.col = col;
+            update.delta = change;
+        } else if (update.row == row && update.col == col)
+        {
+            // Same cell edited again; fold the change into the pending update
+            update.delta.r += change.r;
+            update.delta.i += change.i;
+        } else
+        {
+            return 0;
+        }
+
+        const Complex du = c_mul(update.delta, update.u[col]);
+        update.denom.r = 1 + du.r;
+        update.denom.i = du.i;
+        const float terms = c_abs(du) > 1 ? c_abs(du) : 1;
+        if (c_abs(update.denom) < RANK_ONE_MIN_DENOM * terms)
+        {
+            return 0;
+        }
+    }
+
+    const int updated = cache->updated || col != cols - 1;
+    *residual = complex_refine(rows, cols, matrix, &cache->f, updated ? &update : NULL, x, REFINE_STEPS);
+    if (*residual > RANK_ONE_MAX_RESIDUAL * residual_scale(rows, cols, matrix, x))
+    {
+        return 0;
+    }
+
+    cache->updated = updated;
+    cache->update = update;
+    return 1;
+}
+
+Complex *complex_solve_cached(SolveCache *cache, int rows, int cols, const Complex *matrix,
+                              const Factorization *partial, float *residual, SolvePath *path)
+{
+    Complex x[MAX_ROWS];
+
+    *residual = -1;
+    *path = SOLVE_RREF;
+
+    if (matrix == NULL)
+    {
+        return NULL;
+    }
+
+    if (cache->factored && cache->rows == rows && cache->cols == cols)
+    {
+        int changed = 0;
+        int row = 0;
+        int col = cols - 1;
+        for (int i = 0; i < rows * cols && changed < 2; i++)
+        {
+            if (matrix[i].r != cache->matrix[i].r || matrix[i].i != cache->matrix[i].i)
+            {
+                changed++;
+                row = i / cols;
+                col = i % cols;
+            }
+        }
+
+        if (changed <= 1 && solve_rank_one(cache, matrix, row, col, x, residual))
+        {
+            cache->matrix[row * cols + col] = matrix[row * cols + col];
+            *path = cache->updated ? SOLVE_RANK_ONE : SOLVE_REUSED;
+            return solution_matrix(rows, cols, x);
+        }
+    }
+
+    solve_cache_reset(cache);
+    if (!solve_full(rows, cols, matrix, partial, &cache->f, x, residual))
+    {
+        *residual = -1;
+        return complex_rref(rows, cols, matrix);
+    }
+
+    cache->rows = rows;
+    cache->cols = cols;
+    cache->factored = 1;
+    for (int i = 0; i < rows * cols; i++)
+    {
+        cache->matrix[i] = matrix[i];
+    }
+    *path = SOLVE_FULL;
+    return solution_matrix(rows, cols, x);
+}
+
+void elimination_init(Elimination *e)
+{
+    for (int i = 0; i < MAX_ROWS; i++)
+    {
+        for (int j = 0; j < MAX_COLS; j++)
+        {
+            e->cells[i][j].r = 0;
+            e->cells[i][j].i = 0;
+        }
+    }
+    elimination_resize(e, 1, 1);
+}
+
+void elimination_resize(Elimination *e, int rows, int cols)
+{
+    e->rows = rows;
+    e->cols = cols;
+    e->stalled = 0;
+    lu_reset(&e->f, rows);
+}
+
+void elimination_set(Elimination *e, int row, int col, Complex value)
+{
+    if (value.r == e->cells[row][col].r && value.i == e->cells[row][col].i)
+    {
+        return;
+    }
+    e->cells[row][col] = value;
+
+    // The right-hand side and rows not yet appended are not part of f
+    if (col < e->cols - 1 && row <= e->f.rows)
+    {
+        e->f.rows = row;
+        e->stalled = 0;
+    }
+}
+
+int elimination_step(Elimination *e, int ready)
+{
+    if (e->rows != e->cols - 1 || e->stalled || e->f.rows >= ready || e->f.rows >= e->rows)
+    {
+        return 0;
+    }
+
+    // A row that leaves no usable pivot makes the matrix singular whatever
+    // comes after it, so wait for it or an earlier row to be edited
+    if (!lu_append_row(&e->f, e->cells[e->f.rows]))
+    {
+        e->stalled = 1;
+        return 0;
+    }
+    return 1;
+}
+
+Complex *elimination_matrix(const Elimination *e)
+{
+    Complex *matrix = (Complex *) malloc(sizeof(Complex) * e->rows * e->cols);
+    for (int i = 0; i < e->rows; i++)
+    {
+        for (int j = 0; j < e->cols; j++)
+        {
+            matrix[i * e->cols + j] = e->cells[i][j];
+        }
+    }
+    return matrix;
+}
+
+int solve_cache_covers(const SolveCache *cache, const Elimination *e)
+{
+    if (!cache->factored || cache->rows != e->rows || cache->cols != e->cols)
+    {
+        return 0;
+    }
+
+    // Mirrors what solve_rank_one accepts, short of its numerical checks
+    int changed = 0;
+    for (int i = 0; i < e->rows; i++)
+    {
+        for (int j = 0; j < e->cols; j++)
+        {
+            const Complex a = cache->matrix[i * e->cols + j];
+            if (a.r == e->cells[i][j].r && a.i == e->cells[i][j].i)
+            {
+                continue;
+            }
+            changed++;
+            if (j != e->cols - 1 && cache->updated && (cache->update.row != i || cache->update.col != j))
+            {
+                return 0;
+            }
+        }
+    }
+    return changed <= 1;
+}
@@ -0,0 +1,136 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#define EPSILON 1e-6f
+
+#define MAX_ROWS 9
+#define MAX_COLS 9
+
+#define REFINE_STEPS 4
+
+// A rank-one update is abandoned for a full solve when its denominator has
+// cancelled below this fraction of its terms, or when the refined residual
+// is above this fraction of |A||x| + |b|
+#define RANK_ONE_MIN_DENOM 1e-3f
+#define RANK_ONE_MAX_RESIDUAL 1e-5f
+
+typedef struct {
+    float r;
+    float i;
+} Complex;
+
+// Single precision LU factorization of the square coefficient part of an
+// augmented matrix. Rows are appended one at a time and each row picks its
+// own pivot column (largest remaining magnitude), so pivot[k] is the column
+// eliminated by row k and U[k] is row k after elimination by rows 0..k-1.
+typedef struct {
+    int size;
+    int rows;
+    int pivot[MAX_ROWS];
+    Complex L[MAX_ROWS][MAX_ROWS];
+    Complex U[MAX_ROWS][MAX_ROWS];
+} Factorization;
+
+// A = A0 + delta * e_row * e_col^T, with A0 the factored matrix.
+// u = A0^-1 e_row and denom = 1 + delta * u[col] (Sherman-Morrison).
+typedef struct {
+    int row;
+    int col;
+    Complex delta;
+    Complex denom;
+    Complex u[MAX_ROWS];
+} RankOne;
+
+// SOLVE_REUSED is the cached factorization without any update, when nothing
+// or only the right-hand side changed
+typedef enum {
+    SOLVE_RREF,
+    SOLVE_FULL,
+    SOLVE_REUSED,
+    SOLVE_RANK_ONE
+} SolvePath;
+
+// What is kept from the last solve so that editing a single cell can be
+// handled in O(n^2): the matrix that was solved, the factorization of its
+// coefficient part and at most one pending rank-one update on top of it
+typedef struct {
+    int rows;
+    int cols;
+    int factored;
+    int updated;
+    Complex matrix[MAX_ROWS * MAX_COLS];
+    Factorization f;
+    RankOne update;
+} SolveCache;
+
+// Factorization of a matrix that is still being entered. Cells are stored as
+// they are committed and the first ready rows are appended to f a step at a
+// time, so that solving only has to eliminate the rows that are left. Editing
+// a coefficient drops the rows of f from that row on.
+typedef struct {
+    int rows;
+    int cols;
+    int stalled;
+    Complex cells[MAX_ROWS][MAX_COLS];
+    Factorization f;
+} Elimination;
+
+float c_abs(Complex a);
+
+Complex c_div(Complex a, Complex b);
+
+Complex c_mul(Complex a, Complex b);
+
+Complex c_sub(Complex a, Complex b);
+
+Complex c_scale(Complex a, float s);
+
+// RREF of A in place, without allocating. Returns the number of pivots found
+// left of the last column, which is the rank of the coefficient part when the
+// last column is the right-hand side.
+int complex_rref_inplace(int rows, int cols, Complex *A);
+
+Complex *complex_rref(int rows, int cols, const Complex *matrix);
+
+void lu_reset(Factorization *f, int size);
+
+int lu_append_row(Factorization *f, const Complex *row);
+
+void lu_solve(const Factorization *f, const Complex *b, Complex *x);
+
+// lu_solve for f's matrix plus the update, when update is not NULL
+void lu_solve_updated(const Factorization *f, const RankOne *update, const Complex *b, Complex *x);
+
+float complex_refine(int rows, int cols, const Complex *matrix, const Factorization *f, const RankOne *update,
+                     Complex *x, int steps);
+
+Complex *complex_solve(int rows, int cols, const Complex *matrix, float *residual);
+
+void solve_cache_reset(SolveCache *cache);
+
+// complex_solve, reusing the cache when matrix differs from the last solved
+// one in a single cell. path reports which way the result was computed.
+// partial, when not NULL, is a factorization of the first partial->rows rows
+// of matrix to continue from when the cache cannot be used.
+Complex *complex_solve_cached(SolveCache *cache, int rows, int cols, const Complex *matrix,
+                              const Factorization *partial, float *residual, SolvePath *path);
+
+void elimination_init(Elimination *e);
+
+void elimination_resize(Elimination *e, int rows, int cols);
+
+void elimination_set(Elimination *e, int row, int col, Complex value);
+
+// Appends the next of the first ready rows to the factorization. Returns 0
+// when there is nothing left to do.
+int elimination_step(Elimination *e, int ready);
+
+// The entered cells as a rows x cols matrix
+Complex *elimination_matrix(const Elimination *e);
+
+// Whether the entered matrix is one edit away from the cached one that the
+// cache can take (no change, the right-hand side, or one coefficient), so
+// that e's factorization is not needed
+int solve_cache_covers(const SolveCache *cache, const Elimination *e);
+
+#endif